@@ -0,0 +1,45 @@
+#ifndef ATTACHMENT_STORE_H
+#define ATTACHMENT_STORE_H
+
+#include "database_handler.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+
+// Metadata of a file attached to a message, the bytes stay in the database until downloaded
+struct AttachmentInfo {
+    std::string message_id;
+    std::string room_id;
+    std::string sha256;
+    std::string file_name;
+    std::int64_t size_bytes = 0;
+};
+
+// Attachments are stored outside the messages table, split in fixed size chunks
+// and deduplicated by the SHA-256 of their content. Uploads and downloads stream
+// one chunk at a time so memory use does not depend on the file size. The contents
+// are stored with the room (on its shard), so deduplication is per database.
+class AttachmentStore {
+private:
+    DatabaseHandler& db_handler;
+
+    static std::string hash_file(const std::string& path, std::int64_t& size_bytes);
+    std::string upload(const std::string& room_id, const std::string& path, std::int64_t& size_bytes);
+
+public:
+    static constexpr std::size_t CHUNK_SIZE = 256 * 1024;
+
+    explicit AttachmentStore(DatabaseHandler& db);
+
+    // Upload a file (if its content is not stored yet) and post it as a message of the room
+    AttachmentInfo send_attachment(const std::string& room_id, const std::string& sender_id, const std::string& path);
+
+    // Attachment metadata of a room, keyed by message_id. No content is transferred.
+    std::map<std::string, AttachmentInfo, std::less<>> get_room_attachments(const std::string& room_id);
+
+    // Write the content of an attachment to a local file, chunk by chunk
+    void download(const AttachmentInfo& attachment, const std::string& output_path);
+};
+
+#endif // ATTACHMENT_STORE_H
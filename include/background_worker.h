@@ -0,0 +1,44 @@
+#ifndef BACKGROUND_WORKER_H
+#define BACKGROUND_WORKER_H
+
+#include <glibmm/dispatcher.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// One worker thread running tasks in order. Each task can have a completion
+// callback, run afterwards on the GTK main loop. Destroying the worker waits for
+// the running task and drops pending ones, so callbacks never outlive their owner.
+class BackgroundWorker {
+private:
+    struct Task {
+        std::function<void()> work;
+        std::function<void()> done;
+    };
+
+    std::mutex mutex;
+    std::condition_variable wake_up;
+    std::deque<Task> tasks;
+    std::deque<std::function<void()>> main_loop_callbacks;
+    bool stopping = false;
+
+    Glib::Dispatcher dispatcher;
+    std::thread thread;
+
+    void run();
+    void on_dispatch();
+
+public:
+    BackgroundWorker();
+    ~BackgroundWorker();
+
+    // Must be called from the GTK main loop
+    void post(std::function<void()> work, std::function<void()> done = {});
+
+    // Can be called from the worker thread
+    void post_to_main_loop(std::function<void()> callback);
+};
+
+#endif // BACKGROUND_WORKER_H
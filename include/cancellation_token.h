@@ -0,0 +1,53 @@
+#ifndef CANCELLATION_TOKEN_H
+#define CANCELLATION_TOKEN_H
+
+#include "connection_pool.h"
+#include <pqxx/pqxx>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+
+// Thrown by database calls whose token was cancelled before or while they ran
+class OperationCancelled : public std::runtime_error {
+public:
+    OperationCancelled() : std::runtime_error("Operation cancelled") {}
+};
+
+// Shared by a view and the loads it starts. Cancelling marks the token and, when a
+// query is running on a bound connection, asks the server to abort it through the
+// libpq cancel request, so the backend stops working on a result nobody will read.
+// A cancel request is not tied to a statement: one arriving after the query finished
+// aborts whatever the connection runs next, so a connection it was sent to is closed
+// instead of given back to its pool.
+class CancellationToken {
+private:
+    std::atomic<bool> cancelled{false};
+    std::mutex mutex;
+    pqxx::connection* connection = nullptr;
+    bool cancel_sent = false;
+
+public:
+    // Can be called from any thread, any number of times
+    void cancel();
+    bool is_cancelled() const { return cancelled.load(); }
+
+    // Throws OperationCancelled when the token was already cancelled
+    void throw_if_cancelled() const;
+
+    // Attach the connection running the queries of the operation for its duration.
+    // Declared after the PooledConnection, so it is unbound before it is given back.
+    class Binding {
+    private:
+        CancellationToken* token;
+        PooledConnection& connection;
+
+    public:
+        // A null token binds nothing, so callers can pass an optional token through
+        Binding(CancellationToken* token, PooledConnection& connection);
+        ~Binding();
+        Binding(const Binding&) = delete;
+        Binding& operator=(const Binding&) = delete;
+    };
+};
+
+#endif // CANCELLATION_TOKEN_H
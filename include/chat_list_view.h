@@ -6,8 +6,11 @@
 #include <gtkmm.h>
 #include "database_handler.h"
 #include "user.h"
+#include "tracer.h"
 #include "chat_room_view.h"
 #include "new_chat_room_view.h"
+#include "presence_service.h"
+#include <unordered_map>
 
 class ChatListView : public Gtk::Box {
 private:
@@ -20,29 +23,62 @@ private:
     Gtk::ScrolledWindow scroll;
     Gtk::ListBox chat_list;
     Gtk::Button new_chat_button;
+    Gtk::Button search_button;
     Gtk::Button logout_button;
+    Gtk::ListBoxRow* hovered_row = nullptr;
+
+    // Rooms ordered by latest activity, higher rank first
+    std::unordered_map<std::string, std::uint64_t> room_ranks;
+    std::uint64_t last_rank = 0;
+
+    // Presence shown next to each room name
+    std::unordered_map<std::string, Gtk::Label*> presence_labels;
+
+    // Room activity collected until the next frame, room_id -> room_name
+    std::vector<std::pair<std::string, std::string>> pending_activity;
+    guint update_tick_id = 0;
     
     // Private methods
     void on_chat_row_activated(Gtk::ListBoxRow* row);
-    bool on_button_press_event(GdkEventButton* event);
+    bool on_motion_notify_event(GdkEventMotion* event);
+    void on_row_selected(Gtk::ListBoxRow* row);
+    void emit_room_hovered(Gtk::ListBoxRow* row);
     void on_new_chat_room_clicked();
     void load_conversations();
+    void append_room_row(const std::string& room_id, const std::string& room_name);
+    int compare_rows(Gtk::ListBoxRow* first, Gtk::ListBoxRow* second);
+    bool on_update_tick(const Glib::RefPtr<Gdk::FrameClock>& frame_clock);
     void on_logout_clicked();
 
     // Signals
     sigc::signal<void> m_signal_create_new_chat_room;
     sigc::signal<void> m_signal_logout;
+    sigc::signal<void> m_signal_search_requested;
 
     typedef sigc::signal<void, std::string, std::string> type_signal_open_chat_room;
     type_signal_open_chat_room m_signal_open_chat_room;
+
+    typedef sigc::signal<void, std::string> type_signal_room_hovered;
+    type_signal_room_hovered m_signal_room_hovered;
     
 public:
     ChatListView(DatabaseHandler& db);
+    virtual ~ChatListView();
+
+    // Move a room to the top (adding it if missing), applied with other updates on the next frame
+    void queue_room_activity(const std::string& room_id, const std::string& room_name);
+
+    // Mark the rooms where someone is online or typing
+    void show_presence(const PresenceSnapshot& presence);
 
     // Signals getters
     sigc::signal<void>& signal_create_new_chat_room() { return m_signal_create_new_chat_room; }
     sigc::signal<void>& signal_logout() { return m_signal_logout; }
+    sigc::signal<void>& signal_search_requested() { return m_signal_search_requested; }
     type_signal_open_chat_room signal_open_chat_room() { return m_signal_open_chat_room; }
+
+    // Emitted with the room_id of a row the pointer moves onto or that gets selected
+    type_signal_room_hovered signal_room_hovered() { return m_signal_room_hovered; }
 };
 
 #endif
\ No newline at end of file
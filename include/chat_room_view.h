@@ -5,7 +5,24 @@
 #include <gtkmm.h>
 #include "database_handler.h"
 #include "user.h"
+#include "tracer.h"
+#include "room_snapshot.h"
+#include "attachment_store.h"
+#include "background_worker.h"
+#include "message_store.h"
+#include "cancellation_token.h"
+#include "in_flight_limit.h"
+#include "text_search.h"
+#include "presence_service.h"
+#include <unordered_map>
+#include <memory>
+#include <deque>
+#include <chrono>
 #include <iostream>
+#include <unordered_set>
+#include <map>
+#include <string_view>
+#include <functional>
 
 class ChatRoomView : public Gtk::Box {
 private:
@@ -15,6 +32,76 @@ private:
     std::string room_name;
     std::string last_message_sender_id;
 
+    // Last message fetched from the database. History pages never overlap, only our own
+    // messages, shown as soon as they are sent, come back from the database a second time.
+    std::string last_message_id;
+    std::chrono::system_clock::time_point last_message_time;
+    std::unordered_set<std::string> sent_message_ids;
+
+    // Oldest displayed message, earlier pages are prepended before it
+    std::string first_message_id;
+    std::chrono::system_clock::time_point first_message_time;
+    std::string first_message_sender_id;
+    Gtk::Label* first_message_header = nullptr;
+
+    // Streaming state of the initial history load
+    bool history_loading = false;
+    bool history_stream_done = false;
+    bool history_interrupted = false;
+    std::string oldest_fetched_id;
+    std::chrono::system_clock::time_point oldest_fetched_time;
+    std::shared_ptr<CancellationToken> history_token;
+
+    // The stream waits while HISTORY_CHUNKS_IN_FLIGHT chunks are posted and not rendered,
+    // so a slow main loop holds a couple of chunks and not the whole room
+    std::shared_ptr<InFlightLimit> history_flow;
+
+    // Received chunks not rendered yet, and rows left in the front one
+    std::deque<std::shared_ptr<MessageStore>> pending_chunks;
+    std::size_t pending_rows = 0;
+    sigc::connection render_idle;
+
+    // Live updates collected until the next frame
+    std::vector<Message> pending_messages;
+    std::optional<RoomInfo> pending_info;
+    guint update_tick_id = 0;
+
+    // In-room find (Ctrl+F) over the loaded history, message widgets in history order.
+    // The current match is kept as index minus prepended_count, which prepends do not move.
+    FindIndex find_index;
+    std::deque<Gtk::Box*> message_widgets;
+    std::vector<std::size_t> find_matches;
+    std::optional<std::int64_t> find_current;
+    std::vector<Gtk::Widget*> find_highlighted;
+
+    // Opened at a search result or a date: only a page around it is loaded, newer pages on demand
+    std::string anchor_message_id;
+    std::optional<std::chrono::system_clock::time_point> anchor_time;
+    bool has_later_messages = false;
+
+    std::optional<double> distance_from_bottom;
+    Gtk::Widget* scroll_target = nullptr;
+    sigc::connection scroll_anchor_release;
+
+    // Usernames of the senders, read on the worker before their messages are displayed.
+    // resolved_sender_ids, the ids already looked up, is only used on the worker.
+    std::map<std::string, std::string, std::less<>> usernames;
+    std::unordered_set<std::string> resolved_sender_ids;
+    RoomPresence shown_presence;
+
+    // Member browser, pages of members fetched while its popover is open, the next page
+    // follows the last listed user_id
+    std::vector<std::string> member_names;
+    std::string members_after_id;
+    bool members_loading = false;
+    bool members_complete = false;
+    unsigned members_generation = 0;
+
+    // Files attached to the room messages, keyed by message_id (metadata only)
+    using AttachmentMap = std::map<std::string, AttachmentInfo, std::less<>>;
+    AttachmentStore attachment_store;
+    AttachmentMap attachments;
+
     // GUI Components 
     Gtk::Box main_box;
     Gtk::ScrolledWindow message_scroll;
@@ -23,23 +110,131 @@ private:
     Gtk::Entry message_entry;
     Gtk::Button send_button;
     Gtk::Button go_back_button;
+    Gtk::Button attach_button;
+    Gtk::MenuButton jump_button;
+    Gtk::Popover jump_popover;
+    Gtk::Box jump_box;
+    Gtk::Calendar jump_calendar;
+    Gtk::Button jump_go_button;
     Gtk::Label room_label;
+    Gtk::Box users_box;
     Gtk::Label* users_label;
+    Gtk::MenuButton members_button;
+    Gtk::Popover members_popover;
+    Gtk::Box members_box;
+    Gtk::ScrolledWindow members_scroll;
+    Gtk::ListBox members_list;
+    Gtk::Button members_more_button;
+    Gtk::Label presence_label;
+    Gtk::Button load_earlier_button;
+    Gtk::Button load_later_button;
+    Gtk::SearchBar find_bar;
+    Gtk::Box find_box;
+    Gtk::SearchEntry find_entry;
+    Gtk::Button find_previous_button;
+    Gtk::Button find_next_button;
+    Gtk::Label find_count_label;
 
     // Methods
     void on_send_clicked();
     void on_go_back_clicked();
     void load_messages();
-    void add_message(const std::string& content, const std::string& sender_id, bool is_from_current_user);
+    void load_snapshot(RoomSnapshot& snapshot);
+    void on_load_earlier_clicked();
+    void load_window();
+    void show_window(RoomSnapshot& window);
+    void on_load_later_clicked();
+    void show_later_messages(std::vector<Message>& messages);
+    void on_jump_to_date();
+    void reset_history();
+    void cancel_history_load();
+    void show_room_info(const RoomInfo& info);
+    void set_members_text(const MemberSummary& members);
+    void reset_members();
+    void load_members_page();
+    void show_members_page(unsigned generation, std::vector<RoomMember> page, const std::string& error);
+    void load_attachments(std::function<void()> loaded_callback = {});
+    const AttachmentInfo* find_attachment(std::string_view message_id) const;
+    void on_attach_clicked();
+    void on_download_clicked(AttachmentInfo attachment);
+    void show_new_messages(const std::vector<Message>& messages, std::optional<AttachmentMap> loaded_attachments,
+                           bool new_sender);
+    void queue_message(const Message& msg);
+    void queue_room_info(RoomInfo info);
+    void schedule_updates();
+    bool on_update_tick(const Glib::RefPtr<Gdk::FrameClock>& frame_clock);
+    void apply_pending_updates();
+    bool on_view_key_press(GdkEventKey* event);
+    void on_find_changed();
+    void on_find_step(int direction);
+    void show_find_match();
+    void clear_find_highlights();
+    void scroll_to_widget(Gtk::Widget& widget);
+    const std::string& username_for(std::string_view sender_id) const;
+    bool resolve_senders(const std::vector<std::string>& sender_ids);
+    Gtk::Box* add_message(const std::string& content, const std::string& sender_id, bool is_from_current_user,
+                     const AttachmentInfo* attachment = nullptr);
+    void prepend_messages(const MessageStore& chunk);
+    Gtk::Box* start_history_batch();
+    void prepend_message(const MessageStore& chunk, const MessageRow& row, Gtk::Box& batch);
+    void on_history_chunk(std::shared_ptr<MessageStore> chunk);
+    bool on_render_idle();
+    void on_history_loaded(bool interrupted);
+    void finish_history_load();
+    void remember_scroll_position();
+    void on_scroll_range_changed();
+    Gtk::Box* create_message_widget(const std::string& content, std::string_view sender_id,
+                                    bool is_from_current_user, bool show_sender, Gtk::Label** header,
+                                    const AttachmentInfo* attachment);
     void scroll_to_bottom();
 
     // Signal
     sigc::signal<void> m_signal_back_to_chat_list_requested;
+    sigc::signal<void, std::string, std::string> m_signal_room_activity;
+    sigc::signal<void, std::string, bool> m_signal_typing;
+
+    // Uploads and downloads, declared last so it stops before the widgets go away
+    BackgroundWorker worker;
 
 public:
-    ChatRoomView(DatabaseHandler& db_handler, const std::string& room_id, const std::string& room_name);
-    virtual ~ChatRoomView() {}
+    // Messages per page when loading earlier history
+    static constexpr int PAGE_SIZE = 50;
+
+    // Usernames per page of the member browser
+    static constexpr int MEMBERS_PAGE_SIZE = 100;
+
+    // Rows per streamed chunk, the first one is small so the room shows up quickly
+    static constexpr std::size_t FIRST_CHUNK_SIZE = 50;
+    static constexpr std::size_t CHUNK_SIZE = 500;
+    static constexpr std::size_t HISTORY_CHUNKS_IN_FLIGHT = 2;
+
+    // Most matches tinted at once by the find bar, beyond it only the current one is
+    static constexpr std::size_t FIND_HIGHLIGHT_LIMIT = 1000;
+
+    // Main loop time spent rendering history per idle iteration
+    static constexpr std::chrono::milliseconds RENDER_BUDGET{8};
+
+    // With a prefetched snapshot the room is displayed once its attachment list is read,
+    // with an anchor message it opens on the history around that message
+    ChatRoomView(DatabaseHandler& db_handler, const std::string& room_id, const std::string& room_name,
+                 std::optional<RoomSnapshot> snapshot = std::nullopt, const std::string& anchor_message_id = "");
+    virtual ~ChatRoomView();
+
+    // Fetch and display only the messages posted since the last load
+    void refresh();
     sigc::signal<void>& signal_back_to_chat_list_requested() { return m_signal_back_to_chat_list_requested;}
+
+    // Emitted with room_id and room_name once per applied batch of new messages
+    sigc::signal<void, std::string, std::string>& signal_room_activity() { return m_signal_room_activity; }
+
+    // Read the name and members again, after a change notification for the room
+    void reload_room_info();
+
+    // Who else is here and typing
+    void show_presence(const RoomPresence& presence);
+
+    // Emitted with room_id and whether the entry holds a message being written
+    sigc::signal<void, std::string, bool>& signal_typing() { return m_signal_typing; }
 };
 
 #endif 
\ No newline at end of file
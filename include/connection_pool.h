@@ -0,0 +1,65 @@
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include <pqxx/pqxx>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Idle connections to one database, kept for the next operation instead of closed.
+// Each one remembers the statement timeout its session has (0 for none),
+// so the next operation only changes it when it needs another one.
+class ConnectionPool {
+public:
+    struct Idle {
+        std::unique_ptr<pqxx::connection> connection;
+        std::chrono::milliseconds statement_timeout{0};
+        std::chrono::steady_clock::time_point idle_since;
+    };
+
+    ConnectionPool(std::string conn_str, std::size_t max_idle);
+
+    const std::string& connection_string() const { return conn_str; }
+
+    // An idle connection, preferably one with this timeout already, or none
+    Idle take(std::chrono::milliseconds statement_timeout);
+
+    // Kept while fewer than max_idle are, closed otherwise
+    void give_back(Idle idle);
+
+private:
+    std::string conn_str;
+    std::size_t max_idle;
+    std::mutex mutex;
+    std::vector<Idle> idle;
+};
+
+// A connection taken from a pool for the duration of an operation, given back when it
+// goes out of scope if it is still open. Converts to pqxx::connection& for the
+// transactions. A connection without a pool is simply closed.
+class PooledConnection {
+public:
+    PooledConnection(ConnectionPool* pool, ConnectionPool::Idle idle);
+    ~PooledConnection();
+    PooledConnection(PooledConnection&& other) noexcept = default;
+    PooledConnection(const PooledConnection&) = delete;
+    PooledConnection& operator=(const PooledConnection&) = delete;
+    PooledConnection& operator=(PooledConnection&&) = delete;
+
+    pqxx::connection& operator*() { return *idle.connection; }
+    pqxx::connection* operator->() { return idle.connection.get(); }
+    operator pqxx::connection&() { return *idle.connection; }
+
+    // Closed when it goes out of scope instead of given back, its session is in doubt
+    void discard() { discarded = true; }
+
+private:
+    ConnectionPool* pool;
+    ConnectionPool::Idle idle;
+    bool discarded = false;
+};
+
+#endif // CONNECTION_POOL_H
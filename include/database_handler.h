@@ -3,6 +3,15 @@
 
 #include "user.h"
 #include "message.h"
+#include "query_metrics.h"
+#include "message_store.h"
+#include "room_snapshot.h"
+#include "room_cache.h"
+#include "search_result.h"
+#include "cancellation_token.h"
+#include "single_flight.h"
+#include "shard_map.h"
+#include "connection_pool.h"
 #include <pqxx/pqxx>
 #include <openssl/sha.h>
 #include <string>
@@ -15,6 +24,13 @@
 #include <iomanip>
 #include <sstream>
 #include <algorithm>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <future>
+#include <tuple>
+#include <map>
 #include <boost/algorithm/string/join.hpp>
 
 class DatabaseHandler {
@@ -22,12 +38,101 @@ private:
     // Connection string and current user informations
     std::string connStr;
     std::optional<User> current_user;
+    QueryMetrics query_metrics;
+
+    // Names and members of the rooms already read, see RoomChangeListener
+    RoomCache room_cache;
+
+    // Per operation statement timeouts, configured before any query runs
+    std::map<std::string, std::chrono::milliseconds> statement_timeouts;
+
+    // Read replicas, with the WAL position each one is known to have replayed
+    struct Replica {
+        std::string connStr;
+        std::atomic<std::uint64_t> replayed_lsn{0};
+    };
+    std::vector<std::unique_ptr<Replica>> replicas;
+    std::atomic<std::size_t> next_replica{0};
+
+    // Shard databases of the rooms, connStr then only holds users and the room directory
+    ShardMap shards;
+    std::vector<pqxx::result> queryAllShards(const std::string& operation,
+                                             const std::function<pqxx::result(pqxx::work&)>& query);
+
+    // WAL position after our last write, replica reads wait for it (read-your-writes)
+    std::atomic<std::uint64_t> last_write_lsn{0};
+
+    // Idle connections of every database (main, replicas, shards), keyed by connection
+    // string, all created by the constructor
+    std::map<std::string, std::unique_ptr<ConnectionPool>> pools;
+
+    pqxx::connection connect(const std::string& conn_str);
+    PooledConnection acquire(const std::string& conn_str, const std::string& operation);
+    std::chrono::milliseconds statementTimeout(const std::string& operation) const;
+    std::string withStatementTimeout(const std::string& conn_str, const std::string& operation) const;
+    void recordWrite(pqxx::connection& connection);
+    bool waitForReplay(Replica& replica, pqxx::connection& connection, std::uint64_t lsn);
+    static std::uint64_t parseLsn(const std::string& lsn);
     std::chrono::system_clock::time_point parseTimestamp(const std::string& timestamp_str);
+    static std::int64_t parseTimestampSeconds(std::string_view timestamp_str);
+    static std::string formatTimestamp(std::chrono::system_clock::time_point time);
+    std::vector<Message> toMessages(const pqxx::result& result);
+    RoomSnapshot toWindow(const pqxx::result& result, int before_count, int after_count);
+    static std::string roomInfoQuery(pqxx::transaction_base& txn, const std::string& room_id,
+                                     const std::string& viewer_id);
+    static RoomInfo toRoomInfo(const pqxx::result& result);
+    static std::string toArrayLiteral(const std::vector<std::string>& values, std::size_t begin, std::size_t end);
+    void deleteShardRoom(const std::string& room_id);
+
+    // Identical concurrent lookups run once, keyed by their arguments
+    SingleFlight<std::string, std::vector<std::pair<std::string, std::string>>> conversations_flight;
+    SingleFlight<std::string, std::vector<Message>> history_flight;
+    SingleFlight<std::tuple<std::string, std::string, int, bool>, RoomSnapshot> open_room_flight;
+    SingleFlight<std::pair<std::string, std::string>, RoomInfo> room_info_flight;
+    SingleFlight<std::string, std::string> username_flight;
+    std::vector<std::pair<std::string, std::string>> fetch_user_conversations(const std::string& current_user_id);
+    std::vector<Message> fetch_room_messages(const std::string& room_id);
+    RoomSnapshot fetch_open_room(const std::string& room_id, const std::string& viewer_id, int page_size, bool mark_read,
+                                 CancellationToken* cancel);
+    RoomInfo fetch_room_info(const std::string& room_id, const std::string& viewer_id);
+    std::string fetch_username_by_id(const std::string& user_id);
 
 public:
-    // Connection method and constructor
-    explicit DatabaseHandler(const std::string& connStr);
-    pqxx::connection createConnection();
+    // Connection method and constructor, reads are spread over the replicas when given and
+    // rooms are placed on the shards when given (replicas then only serve the global database)
+    explicit DatabaseHandler(const std::string& connStr, const std::vector<std::string>& replicaConnStrs = {},
+                             const std::vector<std::string>& shardConnStrs = {});
+    PooledConnection createConnection();
+
+    // Longest wait for a replica to replay our last write before reading from the primary
+    static constexpr std::chrono::milliseconds READ_YOUR_WRITES_WAIT{100};
+    PooledConnection createReadConnection(const std::string& operation);
+
+    // Connections to the database holding a room
+    PooledConnection createRoomConnection(const std::string& room_id, const std::string& operation);
+    PooledConnection createRoomReadConnection(const std::string& room_id, const std::string& operation);
+
+    // Every database holding rooms: the main one, or each shard. A connection of its own,
+    // never pooled, for sessions that outlive an operation (LISTEN) or run once.
+    std::size_t room_database_count() const { return shards.empty() ? 1 : shards.size(); }
+    pqxx::connection createRoomDatabaseConnection(std::size_t index);
+
+    // Idle connections kept per database, how many warm_up opens in each, and how long
+    // one stays idle before it is checked when taken
+    static constexpr std::size_t POOL_MAX_IDLE = 4;
+    static constexpr std::size_t POOL_WARM_CONNECTIONS = 2;
+    static constexpr std::chrono::seconds POOL_IDLE_CHECK{30};
+
+    // Fill the pool of every database ahead of the first login, off the main loop, false if one failed
+    bool warm_up();
+
+    // Connection whose statements are limited by the timeout configured for the operation
+    PooledConnection createConnection(const std::string& operation);
+    void set_statement_timeout(const std::string& operation, std::chrono::milliseconds timeout);
+
+    // Latency, call, error and row counters of every operation
+    QueryMetrics& getMetrics() { return query_metrics; }
+    RoomCache& getRoomCache() { return room_cache; }
 
     // User management related methods
     void setCurrentUser(const std::optional<User> user);
@@ -38,8 +143,14 @@ public:
     static std::string hashPassword(const std::string& password);
     std::optional<User> verifyUserCredentials(const std::string& username, const std::string& hashedPassword);
 
-    // Chat list related methods
+    // Chat list related methods. get_user_conversations logs a failure and returns an empty
+    // list, load_user_conversations throws it.
     std::vector<std::pair<std::string, std::string>> get_user_conversations(const std::string& current_user_id);
+    std::vector<std::pair<std::string, std::string>> load_user_conversations(const std::string& current_user_id);
+    std::vector<std::string> get_most_active_rooms(const std::string& user_id, int limit);
+
+    // Members written per statement when creating a room, however large the group
+    static constexpr std::size_t MEMBER_INSERT_BATCH = 1000;
 
     // Create new chat room
     std::string get_or_create_chat_room(const std::vector<std::string>& user_ids, const std::string& room_name);
@@ -47,9 +158,49 @@ public:
 
     // Chat room related methods
     std::vector<Message> get_room_messages(const std::string& room_id);
-    std::vector<std::string> get_room_users(const std::string& room_id);
-    void send_message(const std::string room_id, const std::string& sender_id, const std::string& content);
+    void stream_room_messages(const std::string& room_id, std::size_t first_chunk_rows, std::size_t chunk_rows,
+                              const std::function<bool(MessageStore&&)>& on_chunk,
+                              const std::string& before_message_id = "",
+                              std::chrono::system_clock::time_point before_time = {}, CancellationToken* cancel = nullptr);
+
+    // Name, member summary and latest page of a room in a single round trip, optionally marking it read
+    RoomSnapshot open_room(const std::string& room_id, const std::string& viewer_id, int page_size, bool mark_read,
+                           CancellationToken* cancel = nullptr);
+    // Messages posted after a known one, oldest first, limit 0 returns all of them. The known
+    // message comes with its timestamp so only the partitions around it are searched for it.
+    std::vector<Message> get_room_messages_after(const std::string& room_id, const std::string& after_message_id,
+                                                 std::chrono::system_clock::time_point after_time, int limit = 0);
+    std::vector<Message> get_room_messages_before(const std::string& room_id, const std::string& before_message_id,
+                                                  std::chrono::system_clock::time_point before_time, int limit);
+
+    // Page of history around a message (it and the ones before it, then the ones after it)
+    RoomSnapshot get_room_messages_around(const std::string& room_id, const std::string& message_id, int page_size);
+
+    // Page of history from the first message at or after a date (and the ones before it)
+    RoomSnapshot get_room_messages_at(const std::string& room_id, std::chrono::system_clock::time_point when,
+                                      int page_size);
+    void mark_room_messages_read(const std::string& room_id);
+
+    // Names listed by a member summary, the other members are only counted
+    static constexpr int MEMBER_SUMMARY_NAMES = 3;
+
+    // Room name and member summary, from the room cache when it has them
+    RoomInfo get_room_info(const std::string& room_id);
+    RoomInfo get_room_info(const std::string& room_id, const std::string& viewer_id);
+
+    // The other members in user_id order, the page following after_user_id
+    std::vector<RoomMember> get_room_members_page(const std::string& room_id, const std::string& viewer_id,
+                                                  const std::string& after_user_id, int limit);
+    std::string send_message(const std::string room_id, const std::string& sender_id, const std::string& content);
     std::string get_username_by_id(const std::string& user_id);
+    std::map<std::string, std::string> get_usernames_by_id(const std::vector<std::string>& user_ids);
+
+    // Full-text search in the rooms of a user, best match first, the page following the after result
+    std::vector<SearchResult> search_messages(const std::string& user_id, const std::string& terms, int limit,
+                                              const SearchResult* after = nullptr);
+
+    // Creates the messages partitions of the next months, returns how many were missing
+    int maintain_message_partitions(int months_ahead);
 
 };
 
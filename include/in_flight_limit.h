@@ -0,0 +1,32 @@
+#ifndef IN_FLIGHT_LIMIT_H
+#define IN_FLIGHT_LIMIT_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+// Backpressure between a producer thread and the main loop: at most limit items handed
+// over and not consumed yet. The producer blocks in acquire() until the consumer releases
+// one, so a fast producer cannot queue more than the consumer keeps up with.
+class InFlightLimit {
+private:
+    std::mutex mutex;
+    std::condition_variable released;
+    std::size_t limit;
+    std::size_t in_flight = 0;
+    bool closed = false;
+
+public:
+    explicit InFlightLimit(std::size_t limit);
+
+    // Waits for a free slot, false once closed (the producer then stops)
+    bool acquire();
+
+    // An item was consumed or dropped
+    void release();
+
+    // Wakes a blocked producer for good, called when the consumer goes away
+    void close();
+};
+
+#endif // IN_FLIGHT_LIMIT_H
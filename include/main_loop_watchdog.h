@@ -0,0 +1,26 @@
+#ifndef MAIN_LOOP_WATCHDOG_H
+#define MAIN_LOOP_WATCHDOG_H
+
+#include <glibmm.h>
+#include <chrono>
+#include <cstdint>
+
+// Flags GTK main loop stalls: a timer is scheduled every frame budget and
+// any lateness above the budget means the loop was blocked for that long.
+class MainLoopWatchdog {
+private:
+    std::chrono::milliseconds frame_budget;
+    std::chrono::steady_clock::time_point last_tick;
+    sigc::connection timer;
+    std::uint64_t stall_count = 0;
+
+    bool on_tick();
+
+public:
+    explicit MainLoopWatchdog(std::chrono::milliseconds frame_budget);
+    ~MainLoopWatchdog();
+
+    std::uint64_t get_stall_count() const { return stall_count; }
+};
+
+#endif // MAIN_LOOP_WATCHDOG_H
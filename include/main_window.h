@@ -7,7 +7,14 @@
 #include "login_view.h"       
 #include "chat_list_view.h"   
 #include "new_user_view.h"    
+#include "search_view.h"
 #include "user.h" 
+#include "tracer.h"
+#include "room_prefetcher.h"
+#include "presence_service.h"
+#include "room_change_listener.h"
+#include <list>
+#include <map>
 
 class MainWindow : public Gtk::Window {
 private:
@@ -19,7 +26,31 @@ private:
     std::unique_ptr<ChatListView> chat_view;
     std::unique_ptr<NewUserView> new_user_view;
     std::unique_ptr<NewChatRoomView> new_chat_room_view;
-    std::unique_ptr<ChatRoomView> chat_room_view;
+    std::unique_ptr<SearchView> search_view;
+
+    // Chat room views kept alive by room_id, most recently opened first
+    static constexpr std::size_t ROOM_VIEW_CACHE_SIZE = 8;
+    std::map<std::string, std::unique_ptr<ChatRoomView>> room_views;
+    std::list<std::string> room_view_lru;
+    void add_room_view(const std::string& room_id, const std::string& room_name,
+                       std::optional<RoomSnapshot> snapshot, const std::string& anchor_message_id);
+    void remove_room_view(const std::string& room_id);
+    void evict_room_views();
+    void clear_room_views();
+
+    // Background loading of the rooms likely to be opened next
+    static constexpr int PREFETCH_ROOM_COUNT = 5;
+    std::unique_ptr<RoomPrefetcher> prefetcher;
+    void on_room_hovered(const std::string& room_id);
+
+    // Keeps the room cache in sync, open rooms read their name and members again on a change
+    std::unique_ptr<RoomChangeListener> room_changes;
+    void on_room_changed(const std::string& room_id);
+
+    // Online/away status and typing indicators of the logged in user and their rooms
+    std::unique_ptr<PresenceService> presence;
+    void on_presence_changed(const PresenceSnapshot& snapshot);
+    void show_room(const std::string& room_id);
     
     // Signals
     void on_open_chat_room(const std::string& room_id, const std::string& room_name);
@@ -28,6 +59,9 @@ private:
     void on_create_account_requested();
     void on_back_to_login();
     void on_create_new_chat_room();
+    void on_chat_room_created(const std::string& room_id, const std::string& room_name);
+    void on_search_requested();
+    void on_open_search_result(const std::string& room_id, const std::string& room_name, const std::string& message_id);
     void on_back_to_chat_list();
     
 public:
@@ -0,0 +1,110 @@
+#ifndef MESSAGE_STORE_H
+#define MESSAGE_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Bump allocator: bytes are copied into large blocks and only freed all at once
+class Arena {
+private:
+    std::size_t block_size;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cursor = nullptr;
+    std::size_t remaining = 0;
+    std::size_t used = 0;
+    std::size_t reserved = 0;
+
+public:
+    explicit Arena(std::size_t block_size = 64 * 1024);
+    Arena(Arena&&) noexcept = default;
+    Arena& operator=(Arena&&) noexcept = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Copy the bytes into the arena, the view stays valid for the arena lifetime
+    std::string_view store(std::string_view bytes);
+
+    std::size_t bytes_used() const { return used; }
+    std::size_t bytes_reserved() const { return reserved; }
+};
+
+// Maps repeated ids (senders, rooms) to small integer handles, each stored once
+class StringInterner {
+public:
+    using Handle = std::uint32_t;
+
+private:
+    Arena arena{4 * 1024};
+    std::unordered_map<std::string_view, Handle> handles;
+    std::vector<std::string_view> strings;
+
+public:
+    Handle intern(std::string_view text);
+    std::string_view lookup(Handle handle) const { return strings[handle]; }
+    std::size_t size() const { return strings.size(); }
+};
+
+// One message, 56 bytes, the strings point into the store arena
+struct MessageRow {
+    std::string_view message_id;
+    std::string_view content;
+    std::int64_t timestamp;            // seconds since epoch
+    StringInterner::Handle sender;
+    StringInterner::Handle room;
+    bool is_read;
+};
+
+// Chunk of room history as read from the database: contents in an arena, sender and room ids interned, rows
+// kept contiguous for iteration. Messages can be added at both ends (older pages
+// are prepended), rows are addressed by index from the oldest one.
+class MessageStore {
+private:
+    Arena arena;
+    StringInterner ids;
+
+    // Prepended rows are kept reversed in their own vector so both ends grow in O(1)
+    std::vector<MessageRow> older_rows;
+    std::vector<MessageRow> newer_rows;
+
+    MessageRow make_row(std::string_view message_id, std::string_view content,
+                        std::string_view sender_id, std::string_view room_id,
+                        std::int64_t timestamp, bool is_read);
+
+public:
+    MessageStore() = default;
+    MessageStore(MessageStore&&) noexcept = default;
+    MessageStore& operator=(MessageStore&&) noexcept = default;
+    MessageStore(const MessageStore&) = delete;
+    MessageStore& operator=(const MessageStore&) = delete;
+
+    // The views only need to live for the call, the bytes are copied once into the arena
+    const MessageRow& append(std::string_view message_id, std::string_view content,
+                             std::string_view sender_id, std::string_view room_id,
+                             std::int64_t timestamp, bool is_read);
+    const MessageRow& prepend(std::string_view message_id, std::string_view content,
+                              std::string_view sender_id, std::string_view room_id,
+                              std::int64_t timestamp, bool is_read);
+
+    std::size_t size() const { return older_rows.size() + newer_rows.size(); }
+    bool empty() const { return size() == 0; }
+
+    // Index 0 is the oldest message
+    const MessageRow& operator[](std::size_t index) const {
+        return index < older_rows.size() ? older_rows[older_rows.size() - 1 - index]
+                                         : newer_rows[index - older_rows.size()];
+    }
+    const MessageRow& front() const { return (*this)[0]; }
+    const MessageRow& back() const { return (*this)[size() - 1]; }
+
+    // Number of rows prepended so far, an index minus this offset stays stable across prepends
+    std::size_t prepended_count() const { return older_rows.size(); }
+
+    std::string_view sender_id(const MessageRow& row) const { return ids.lookup(row.sender); }
+    std::string_view room_id(const MessageRow& row) const { return ids.lookup(row.room); }
+};
+
+#endif // MESSAGE_STORE_H
@@ -38,10 +38,14 @@ private:
     void on_go_back_clicked();
 
     sigc::signal<void> m_signal_back_to_chat_list_requested;
+    sigc::signal<void, const std::string&, const std::string&> m_signal_chat_room_created;
     
 public:
     NewChatRoomView(DatabaseHandler& db_handler);
     sigc::signal<void>& signal_back_to_chat_list_requested() { return m_signal_back_to_chat_list_requested; }
+
+    // room_id and room_name of the room created, or found with the same members
+    sigc::signal<void, const std::string&, const std::string&>& signal_chat_room_created() { return m_signal_chat_room_created; }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,93 @@
+#ifndef PRESENCE_SERVICE_H
+#define PRESENCE_SERVICE_H
+
+#include "database_handler.h"
+#include <glibmm/dispatcher.h>
+#include <sigc++/sigc++.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Other members of a room seen within the TTL
+struct RoomPresence {
+    std::vector<std::string> online_user_ids;
+    std::vector<std::string> away_user_ids;
+    std::vector<std::string> typing_user_ids;   // typing in this room
+
+    bool operator==(const RoomPresence& other) const {
+        return online_user_ids == other.online_user_ids && away_user_ids == other.away_user_ids
+            && typing_user_ids == other.typing_user_ids;
+    }
+};
+
+// Presence of the rooms of the user, by room_id
+using PresenceSnapshot = std::map<std::string, RoomPresence>;
+
+// Online/away status and typing indicators, kept in the unlogged presence table of the
+// main database, never in messages or users. A worker thread sends one heartbeat per
+// interval over its own connection, each heartbeat also reads back the presence of the
+// user's rooms. State changes between heartbeats are coalesced: a new room or status is
+// sent right away, keystrokes only when the typing flag would otherwise expire.
+class PresenceService {
+private:
+    DatabaseHandler& db_handler;
+    std::string user_id;
+    std::chrono::milliseconds interval;
+    std::chrono::milliseconds ttl;
+
+    // State to send, changed from the main loop
+    std::mutex mutex;
+    std::condition_variable wake_up;
+    bool away = false;
+    std::string room_id;
+    std::string typing_room_id;
+    std::chrono::steady_clock::time_point typing_sent_at;
+    bool dirty = true;
+    bool stopping = false;
+
+    // Latest presence read back, handed to the main loop only when it changed
+    PresenceSnapshot latest;
+    PresenceSnapshot published;
+    Glib::Dispatcher dispatcher;
+    sigc::signal<void, const PresenceSnapshot&> m_signal_presence_changed;
+
+    std::thread worker;
+
+    void run();
+    PresenceSnapshot exchange(pqxx::connection& connection, bool away, const std::string& room_id,
+                              std::chrono::milliseconds typing_left, bool clean_up);
+    void leave(pqxx::connection& connection);
+    void on_dispatch();
+
+public:
+    static constexpr std::chrono::milliseconds DEFAULT_INTERVAL{5000};
+
+    // How long a typing indicator lasts without a new keystroke
+    static constexpr std::chrono::milliseconds TYPING_TTL{6000};
+
+    // Heartbeats between two purges of the rows left by clients that did not leave cleanly
+    static constexpr std::uint64_t CLEAN_UP_EVERY = 120;
+
+    // Rows are ignored after ttl_intervals missed heartbeats
+    PresenceService(DatabaseHandler& db, const std::string& user_id,
+                    std::chrono::milliseconds interval = DEFAULT_INTERVAL, int ttl_intervals = 3);
+    ~PresenceService();
+
+    // Called from the main loop
+    void set_room(const std::string& room_id);
+    void set_away(bool away);
+    void set_typing(const std::string& room_id, bool typing);
+
+    // Last presence emitted, for views created in between
+    const PresenceSnapshot& snapshot() const { return published; }
+
+    // Emitted on the main loop when the presence of a room changed
+    sigc::signal<void, const PresenceSnapshot&>& signal_presence_changed() { return m_signal_presence_changed; }
+};
+
+#endif // PRESENCE_SERVICE_H
@@ -0,0 +1,274 @@
+#ifndef QUERIES_H
+#define QUERIES_H
+
+#include <string>
+
+// Statements issued by the DatabaseHandler, shared with the plan check (tools/plan_check.cpp)
+// so the plans checked there are the ones the app runs. Parameters are noted as $n: name.
+namespace queries {
+
+// $1: username, $2: password_hash
+inline constexpr const char* VERIFY_USER_CREDENTIALS = R"(
+    SELECT user_id, username, password_hash
+    FROM users
+    WHERE username = $1 AND password_hash = $2;
+)";
+
+// Rooms of a user, newest first. $1: user_id
+inline constexpr const char* USER_CONVERSATIONS = R"(
+    SELECT cr.room_id, cr.room_name, EXTRACT(EPOCH FROM cr.created_at) AS created
+    FROM chat_rooms cr
+    INNER JOIN chat_room_members crm ON cr.room_id = crm.room_id
+    WHERE crm.user_id = $1
+    ORDER BY cr.created_at DESC;
+)";
+
+// The latest message of each room is one backward step in messages_room_timestamp.
+// $1: user_id, $2: limit
+inline constexpr const char* MOST_ACTIVE_ROOMS = R"(
+    SELECT crm.room_id, EXTRACT(EPOCH FROM latest.timestamp) AS latest
+    FROM chat_room_members crm
+    LEFT JOIN LATERAL (
+        SELECT m.timestamp
+        FROM messages m
+        WHERE m.room_id = crm.room_id
+        ORDER BY m.timestamp DESC
+        LIMIT 1
+    ) latest ON TRUE
+    WHERE crm.user_id = $1
+    ORDER BY latest.timestamp DESC NULLS LAST
+    LIMIT $2;
+)";
+
+// Only the rooms of one of the members are candidates (room_directory primary key),
+// their memberships are then counted through room_directory_room. The wanted members
+// are hashed once instead of scanning the array for every membership row.
+// $1: member count, $2: member ids array, $3: first member id
+inline constexpr const char* FIND_ROOM = R"(
+    WITH wanted AS (SELECT unnest($2::text[]) AS user_id)
+    SELECT members.room_id
+    FROM room_directory candidate
+    INNER JOIN room_directory members ON members.room_id = candidate.room_id
+    LEFT JOIN wanted ON wanted.user_id = members.user_id
+    WHERE candidate.user_id = $3
+    GROUP BY members.room_id
+    HAVING COUNT(*) = $1 AND COUNT(wanted.user_id) = $1
+    LIMIT 1;
+)";
+
+// $1: room_id, $2: room_name
+inline constexpr const char* CREATE_ROOM =
+    "INSERT INTO chat_rooms (room_id, room_name) VALUES ($1, $2) "
+    "RETURNING room_id;";
+
+// A batch of members. $1: room_id, $2: user ids array
+inline constexpr const char* ADD_ROOM_MEMBERS =
+    "INSERT INTO chat_room_members (room_id, user_id) "
+    "SELECT $1, unnest($2::text[]);";
+
+// Undoes a room created on its shard whose directory rows were not committed, through
+// delete_unlisted_room (init_shard.sql) since the app cannot delete rooms. $1: room_id
+inline constexpr const char* DELETE_UNLISTED_ROOM =
+    "SELECT delete_unlisted_room($1);";
+
+// $1: user ids array, $2: room_id
+inline constexpr const char* ADD_ROOM_DIRECTORY =
+    "INSERT INTO room_directory (user_id, room_id) "
+    "SELECT unnest($1::text[]), $2;";
+
+// $1: user ids array
+inline constexpr const char* USERS_BY_ID =
+    "SELECT user_id, username FROM users WHERE user_id = ANY($1::text[]);";
+
+// Copy of the members' usernames on a room shard. $1: user ids array, $2: usernames array
+inline constexpr const char* COPY_USERS =
+    "INSERT INTO users (user_id, username) "
+    "SELECT * FROM unnest($1::text[], $2::text[]) "
+    "ON CONFLICT (user_id) DO NOTHING;";
+
+// $1: user_id
+inline constexpr const char* ALL_USERS_EXCEPT = R"(
+    SELECT user_id, username
+    FROM users
+    WHERE user_id != $1
+    ORDER BY username;
+)";
+
+// Whole history of a room, oldest first. $1: room_id
+inline constexpr const char* ROOM_HISTORY = R"(
+    SELECT message_id, content, sender_id, timestamp, is_read
+    FROM messages
+    WHERE room_id = $1
+    ORDER BY timestamp ASC, message_id ASC;
+)";
+
+// $1: room_id
+inline constexpr const char* MARK_ROOM_READ = R"(
+    UPDATE messages
+    SET is_read = TRUE
+    WHERE room_id = $1 AND is_read = FALSE;
+)";
+
+// Keyset on (timestamp, message_id), served by the messages_room_timestamp index.
+// The anchor comes with its timestamp as the client has it (to the second, local time):
+// the bounds a day around it are constants the planner prunes partitions with, the
+// anchor lookup included, which by message_id alone probed every month. The exact
+// bounds then come from the anchor row.
+// $1: room_id, $2: after message_id, $3: its timestamp, $4: limit (0 for all)
+inline constexpr const char* MESSAGES_AFTER = R"(
+    WITH anchor AS (
+        SELECT timestamp, message_id FROM messages
+        WHERE message_id = $2
+        AND timestamp BETWEEN $3::timestamp - INTERVAL '1 day' AND $3::timestamp + INTERVAL '1 day'
+    )
+    SELECT message_id, content, sender_id, timestamp, is_read
+    FROM messages
+    WHERE room_id = $1
+    AND timestamp >= $3::timestamp - INTERVAL '1 day'
+    AND timestamp >= (SELECT timestamp FROM anchor)
+    AND (timestamp, message_id) > (SELECT timestamp, message_id FROM anchor)
+    ORDER BY timestamp ASC, message_id ASC
+    LIMIT NULLIF($4, 0);
+)";
+
+// Same anchor bounds as MESSAGES_AFTER, the ordered scan of the partitions stops as
+// soon as the page is full.
+// $1: room_id, $2: before message_id, $3: its timestamp, $4: limit
+inline constexpr const char* MESSAGES_BEFORE = R"(
+    WITH anchor AS (
+        SELECT timestamp, message_id FROM messages
+        WHERE message_id = $2
+        AND timestamp BETWEEN $3::timestamp - INTERVAL '1 day' AND $3::timestamp + INTERVAL '1 day'
+    )
+    SELECT message_id, content, sender_id, timestamp, is_read
+    FROM messages
+    WHERE room_id = $1
+    AND timestamp <= $3::timestamp + INTERVAL '1 day'
+    AND timestamp <= (SELECT timestamp FROM anchor)
+    AND (timestamp, message_id) < (SELECT timestamp, message_id FROM anchor)
+    ORDER BY timestamp DESC, message_id DESC
+    LIMIT $4;
+)";
+
+// The message and the ones before it, then the ones after it, flagged after_anchor.
+// The anchor's bounds are scalar subqueries so they become index conditions, joined
+// with the anchor they only filtered a scan of the whole room.
+// $1: room_id, $2: message_id, $3: rows before, $4: rows after
+inline constexpr const char* MESSAGES_AROUND = R"(
+    WITH anchor AS (
+        SELECT timestamp, message_id FROM messages WHERE room_id = $1 AND message_id = $2
+    )
+    (
+        SELECT m.message_id, m.content, m.sender_id, m.timestamp, m.is_read, FALSE AS after_anchor
+        FROM messages m
+        WHERE m.room_id = $1
+        AND m.timestamp <= (SELECT timestamp FROM anchor)
+        AND (m.timestamp, m.message_id) <= (SELECT timestamp, message_id FROM anchor)
+        ORDER BY m.timestamp DESC, m.message_id DESC
+        LIMIT $3
+    )
+    UNION ALL
+    (
+        SELECT m.message_id, m.content, m.sender_id, m.timestamp, m.is_read, TRUE AS after_anchor
+        FROM messages m
+        WHERE m.room_id = $1
+        AND m.timestamp >= (SELECT timestamp FROM anchor)
+        AND (m.timestamp, m.message_id) > (SELECT timestamp, message_id FROM anchor)
+        ORDER BY m.timestamp ASC, m.message_id ASC
+        LIMIT $4
+    );
+)";
+
+// The messages just before a date, then the ones from it on, flagged after_anchor.
+// $1: room_id, $2: date, $3: rows before, $4: rows after
+inline constexpr const char* MESSAGES_AT = R"(
+    (
+        SELECT message_id, content, sender_id, timestamp, is_read, FALSE AS after_anchor
+        FROM messages
+        WHERE room_id = $1 AND timestamp < $2::timestamp
+        ORDER BY timestamp DESC, message_id DESC
+        LIMIT $3
+    )
+    UNION ALL
+    (
+        SELECT message_id, content, sender_id, timestamp, is_read, TRUE AS after_anchor
+        FROM messages
+        WHERE room_id = $1 AND timestamp >= $2::timestamp
+        ORDER BY timestamp ASC, message_id ASC
+        LIMIT $4
+    );
+)";
+
+// Matches are found through the messages_content_tsv GIN index, then ranked, pages follow
+// on (rank, message_id). $1: user_id, $2: terms, $3: after rank, $4: after message_id
+// ('' for the first page), $5: limit
+inline constexpr const char* SEARCH_MESSAGES = R"(
+    SELECT m.message_id, m.room_id, cr.room_name, u.username, m.content, m.timestamp,
+           ts_rank(m.content_tsv, q.query) AS rank
+    FROM websearch_to_tsquery('english', $2) AS q(query),
+         chat_room_members crm
+         INNER JOIN chat_rooms cr ON cr.room_id = crm.room_id
+         INNER JOIN messages m ON m.room_id = crm.room_id
+         INNER JOIN users u ON u.user_id = m.sender_id
+    WHERE crm.user_id = $1
+    AND m.content_tsv @@ q.query
+    AND ($4 = '' OR (ts_rank(m.content_tsv, q.query), m.message_id COLLATE "C") < ($3::real, $4))
+    ORDER BY rank DESC, m.message_id COLLATE "C" DESC
+    LIMIT $5;
+)";
+
+// $1: message_id, $2: content, $3: sender_id, $4: room_id
+inline constexpr const char* INSERT_MESSAGE = R"(
+    INSERT INTO messages (message_id, content, sender_id, room_id)
+    VALUES ($1, $2, $3, $4);
+)";
+
+// $1: user_id
+inline constexpr const char* USERNAME_BY_ID =
+    "SELECT username FROM users WHERE user_id = $1";
+
+// Keyset on crm.user_id, the order of chat_room_members_pkey: a page reads its rows of
+// the room from the index and joins them to users, whatever the room size. The bound is
+// repeated on u.user_id so a merge join starts users_pkey at the page too.
+// $1: room_id, $2: viewer_id, $3: after user_id, $4: limit
+inline constexpr const char* ROOM_MEMBERS_PAGE = R"(
+    SELECT crm.user_id, u.username
+    FROM chat_room_members crm
+    INNER JOIN users u ON u.user_id = crm.user_id
+    WHERE crm.room_id = $1
+    AND crm.user_id <> $2
+    AND crm.user_id > $3
+    AND u.user_id > $3
+    ORDER BY crm.user_id
+    LIMIT $4;
+)";
+
+// Name, member count and first names of a room. Sent through pipelines, which take no
+// parameters, so the ids come already quoted. The count is an index-only scan of the
+// chat_room_members primary key, names are only joined for the first few members in key
+// order, whatever the size of the room.
+inline std::string room_info(const std::string& quoted_room_id, const std::string& quoted_viewer_id, int names) {
+    std::string members = "FROM chat_room_members WHERE room_id = " + quoted_room_id
+                        + " AND user_id <> " + quoted_viewer_id;
+    return "SELECT cr.room_name, (SELECT COUNT(*) " + members + ") AS member_count, u.username "
+           "FROM chat_rooms cr "
+           "LEFT JOIN (SELECT user_id " + members + " ORDER BY user_id LIMIT "
+           + std::to_string(names) + ") first_members ON TRUE "
+           "LEFT JOIN users u ON u.user_id = first_members.user_id "
+           "WHERE cr.room_id = " + quoted_room_id;
+}
+
+// The page open_room reads. Built as text for its pipeline, which takes no parameters, so
+// the room id comes already quoted. A merge of the per month index scans, each only read
+// until the page is full.
+inline std::string latest_messages(const std::string& quoted_room_id, int limit) {
+    return "SELECT message_id, content, sender_id, timestamp, is_read "
+           "FROM messages "
+           "WHERE room_id = " + quoted_room_id + " "
+           "ORDER BY timestamp DESC, message_id DESC "
+           "LIMIT " + std::to_string(limit);
+}
+
+} // namespace queries
+
+#endif // QUERIES_H
@@ -0,0 +1,116 @@
+#ifndef QUERY_METRICS_H
+#define QUERY_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Log-linear latency histogram (HDR-style) in microseconds.
+// Values below 8us get their own bucket, above that every power of two is split
+// into 8 linear sub-buckets, which bounds the relative error to 12.5%.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 3;
+    static constexpr int SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static constexpr int BUCKET_COUNT = SUB_BUCKET_COUNT + (64 - SUB_BUCKET_BITS) * SUB_BUCKET_COUNT;
+
+    void record(std::uint64_t micros);
+
+    std::uint64_t count() const { return total_count.load(std::memory_order_relaxed); }
+    std::uint64_t sum() const { return total_sum.load(std::memory_order_relaxed); }
+    std::uint64_t max() const { return max_value.load(std::memory_order_relaxed); }
+
+    // Upper bound (in us) of the bucket holding the q-th quantile, q in [0, 1]
+    std::uint64_t percentile(double q) const;
+
+    // Number of recorded values lower or equal to the given bound
+    std::uint64_t count_at_or_below(std::uint64_t micros) const;
+
+    static int bucket_index(std::uint64_t micros);
+    static std::uint64_t bucket_upper_bound(int index);
+
+private:
+    std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> buckets{};
+    std::atomic<std::uint64_t> total_count{0};
+    std::atomic<std::uint64_t> total_sum{0};
+    std::atomic<std::uint64_t> max_value{0};
+};
+
+// Counters kept for every DatabaseHandler operation
+struct OperationStats {
+    std::string name;
+    LatencyHistogram latency;
+    std::atomic<std::uint64_t> calls{0};
+    std::atomic<std::uint64_t> errors{0};
+    std::atomic<std::uint64_t> rows{0};
+    std::atomic<std::uint64_t> coalesced{0};   // calls answered by another caller's in-flight query
+};
+
+// Counters kept for every client-side cache
+struct CacheStats {
+    std::string name;
+    std::atomic<std::uint64_t> hits{0};
+    std::atomic<std::uint64_t> misses{0};
+    std::atomic<std::uint64_t> invalidations{0};
+};
+
+class QueryMetrics {
+public:
+    // RAII timer around one operation, records on destruction
+    class Scope {
+    public:
+        explicit Scope(OperationStats& stats);
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope();
+
+        void rows(std::size_t count) { row_count += count; }
+        void fail() { failed = true; }
+
+    private:
+        OperationStats& stats;
+        std::chrono::steady_clock::time_point start;
+        std::size_t row_count = 0;
+        bool failed = false;
+    };
+
+    // RAII timer around a connection attempt, failed if left through an exception
+    class AcquireScope {
+    public:
+        explicit AcquireScope(QueryMetrics& metrics);
+        AcquireScope(const AcquireScope&) = delete;
+        AcquireScope& operator=(const AcquireScope&) = delete;
+        ~AcquireScope();
+
+    private:
+        QueryMetrics& metrics;
+        std::chrono::steady_clock::time_point start;
+        int exceptions_on_entry;
+    };
+
+    // Lookup (or create) the stats of an operation, the returned reference stays valid
+    OperationStats& operation(const std::string& name);
+
+    // Lookup (or create) the stats of a cache, the returned reference stays valid
+    CacheStats& cache(const std::string& name);
+
+    // Connection acquisition
+    void record_connection_acquire(std::chrono::steady_clock::duration elapsed, bool ok);
+
+    // Export in the Prometheus text exposition format
+    std::string to_prometheus() const;
+    bool write_prometheus_file(const std::string& path) const;
+
+private:
+    mutable std::mutex mutex;
+    std::map<std::string, std::unique_ptr<OperationStats>> operations;
+    std::map<std::string, std::unique_ptr<CacheStats>> caches;
+    OperationStats connection_acquire;
+};
+
+#endif // QUERY_METRICS_H
@@ -0,0 +1,51 @@
+#ifndef ROOM_CACHE_H
+#define ROOM_CACHE_H
+
+#include "query_metrics.h"
+#include "room_snapshot.h"
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// Name and member summary of a room, as seen by one viewer
+struct RoomInfo {
+    std::string room_name;
+    MemberSummary members;
+};
+
+// Room metadata and membership already read, keyed by room_id. Entries are only trusted
+// while room change notifications are received (RoomChangeListener): each notification
+// drops its room, and everything is dropped whenever notifications may have been missed.
+// Thread-safe, filled from the worker threads.
+class RoomCache {
+private:
+    struct Entry {
+        std::string viewer_id;
+        RoomInfo info;
+    };
+
+    CacheStats& stats;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    std::uint64_t epoch = 0;   // bumped on every invalidation
+    bool listening = false;
+
+public:
+    explicit RoomCache(CacheStats& stats) : stats(stats) {}
+
+    std::optional<RoomInfo> get(const std::string& room_id, const std::string& viewer_id);
+
+    // Taken before reading a room, put then ignores what an invalidation may have outdated
+    std::uint64_t current_epoch() const;
+    void put(const std::string& room_id, const std::string& viewer_id, RoomInfo info, std::uint64_t read_epoch);
+
+    // A member joined or left, or the room was renamed
+    void invalidate(const std::string& room_id);
+
+    // Called by the listener when notifications start or stop flowing, empties the cache
+    void set_listening(bool listening);
+};
+
+#endif // ROOM_CACHE_H
@@ -0,0 +1,57 @@
+#ifndef ROOM_CHANGE_LISTENER_H
+#define ROOM_CHANGE_LISTENER_H
+
+#include "database_handler.h"
+#include <glibmm/dispatcher.h>
+#include <sigc++/sigc++.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Keeps the room cache of the DatabaseHandler exact: LISTENs on the room_changed channel of
+// every database holding rooms (one thread and connection each), where triggers send the
+// room_id whenever a member joins or leaves or the room is renamed. The cache is only used
+// while every database is listened to, and emptied whenever a connection is lost.
+class RoomChangeListener {
+private:
+    DatabaseHandler& db_handler;
+    std::size_t database_count;
+
+    std::mutex mutex;
+    std::condition_variable wake_up;
+    bool stopping = false;
+    std::size_t listening_count = 0;
+
+    // Rooms changed since the main loop last looked
+    std::set<std::string> changed_room_ids;
+    Glib::Dispatcher dispatcher;
+    sigc::signal<void, const std::string&> m_signal_room_changed;
+
+    std::vector<std::thread> workers;
+
+    void run(std::size_t database_index);
+    void set_listening(bool listening);
+    void on_room_changed(const std::string& room_id);
+    void on_dispatch();
+
+public:
+    static constexpr const char* CHANNEL = "room_changed";
+
+    // How long a worker waits on its socket before checking whether to stop
+    static constexpr std::chrono::milliseconds POLL_INTERVAL{250};
+
+    // Wait before connecting again after a failure
+    static constexpr std::chrono::milliseconds RETRY_INTERVAL{5000};
+
+    explicit RoomChangeListener(DatabaseHandler& db);
+    ~RoomChangeListener();
+
+    // Emitted on the main loop with the room_id of every changed room
+    sigc::signal<void, const std::string&>& signal_room_changed() { return m_signal_room_changed; }
+};
+
+#endif // ROOM_CHANGE_LISTENER_H
@@ -0,0 +1,58 @@
+#ifndef ROOM_PREFETCHER_H
+#define ROOM_PREFETCHER_H
+
+#include "database_handler.h"
+#include "room_snapshot.h"
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+// Loads the members and latest messages of rooms the user is likely to open next,
+// on a low priority worker thread, within a memory budget.
+class RoomPrefetcher {
+private:
+    DatabaseHandler& db_handler;
+    std::string user_id;
+    std::size_t memory_budget;
+
+    // Pending work
+    std::mutex mutex;
+    std::condition_variable wake_up;
+    std::deque<std::string> queue;
+    int recent_rooms_requested = 0;
+    bool stopping = false;
+
+    // Prefetched rooms, least recently prefetched at the back
+    std::map<std::string, RoomSnapshot> snapshots;
+    std::list<std::string> snapshot_lru;
+    std::size_t memory_used = 0;
+
+    std::thread worker;
+
+    void run();
+    void store(const std::string& room_id, RoomSnapshot snapshot);
+    bool is_known(const std::string& room_id) const;
+
+public:
+    // Messages prefetched per room
+    static constexpr int PAGE_SIZE = 50;
+
+    RoomPrefetcher(DatabaseHandler& db, const std::string& user_id, std::size_t memory_budget = 8 * 1024 * 1024);
+    ~RoomPrefetcher();
+
+    // Queue the rooms with the most recent activity
+    void prefetch_recent(int room_count);
+
+    // Queue a room ahead of everything else, e.g. hovered or selected in the chat list
+    void prefetch(const std::string& room_id);
+
+    // Hand over a prefetched room, if ready
+    std::optional<RoomSnapshot> take(const std::string& room_id);
+};
+
+#endif // ROOM_PREFETCHER_H
@@ -0,0 +1,43 @@
+#ifndef ROOM_SNAPSHOT_H
+#define ROOM_SNAPSHOT_H
+
+#include "message.h"
+#include <optional>
+#include <string>
+#include <vector>
+
+// Members of a room other than the viewer: how many, and the names of the first few
+struct MemberSummary {
+    std::size_t count = 0;
+    std::vector<std::string> first_names;  // sorted, a few at most
+};
+
+// One member of a room, as listed by the member browser
+struct RoomMember {
+    std::string user_id;
+    std::string username;
+};
+
+// Data needed to display a room without querying: members and the latest page of messages
+struct RoomSnapshot {
+    std::string room_name;                 // empty when it could not be read
+    std::optional<MemberSummary> members;  // missing when they could not be read
+    std::vector<Message> messages;  // oldest first
+    bool has_earlier_messages = false;
+    bool has_later_messages = false;  // only for a page around a given message
+
+    // Approximate heap footprint, used to respect the prefetch memory budget
+    std::size_t memory_size() const {
+        std::size_t size = sizeof(RoomSnapshot) + room_name.capacity();
+        if (members) {
+            for (const auto& name : members->first_names) size += sizeof(std::string) + name.capacity();
+        }
+        for (const auto& msg : messages) {
+            size += sizeof(Message) + msg.message_id.capacity() + msg.content.capacity()
+                  + msg.sender_id.capacity() + msg.room_id.capacity();
+        }
+        return size;
+    }
+};
+
+#endif // ROOM_SNAPSHOT_H
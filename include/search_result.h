@@ -0,0 +1,19 @@
+#ifndef SEARCH_RESULT_H
+#define SEARCH_RESULT_H
+
+#include <chrono>
+#include <string>
+
+// One message matching a full-text search, with where it was posted.
+// The next page starts after the (rank, message_id) of the last result.
+struct SearchResult {
+    std::string message_id;
+    std::string room_id;
+    std::string room_name;
+    std::string sender_name;
+    std::string content;
+    std::chrono::system_clock::time_point timestamp;
+    float rank = 0;
+};
+
+#endif // SEARCH_RESULT_H
@@ -0,0 +1,62 @@
+#ifndef SEARCH_VIEW_H
+#define SEARCH_VIEW_H
+
+#pragma once
+#include <gtkmm.h>
+#include "database_handler.h"
+#include "background_worker.h"
+#include "search_result.h"
+#include "tracer.h"
+#include <vector>
+
+// Full-text search over the messages of the user's rooms, results one page at a time
+class SearchView : public Gtk::Box {
+private:
+    DatabaseHandler& db_handler;
+
+    // Results shown so far, in row order, and the search they belong to
+    std::vector<SearchResult> results;
+    std::string terms;
+    unsigned search_generation = 0;
+
+    // Widgets
+    Gtk::Box main_box;
+    Gtk::Label title_label;
+    Gtk::SearchEntry search_entry;
+    Gtk::ScrolledWindow results_scroll;
+    Gtk::ListBox results_list;
+    Gtk::Label status_label;
+    Gtk::Button more_button;
+    Gtk::Button go_back_button;
+
+    // Methods
+    void on_search_activated();
+    void on_more_clicked();
+    void load_page();
+    void show_page(unsigned generation, std::vector<SearchResult> page, const std::string& error);
+    void append_result_row(const SearchResult& result);
+    void on_result_activated(Gtk::ListBoxRow* row);
+    void on_go_back_clicked();
+
+    // Signals
+    sigc::signal<void> m_signal_back_to_chat_list_requested;
+    sigc::signal<void, std::string, std::string, std::string> m_signal_open_search_result;
+
+    // Searches run here, declared last so it stops before the widgets go away
+    BackgroundWorker worker;
+
+public:
+    // Results per page
+    static constexpr int PAGE_SIZE = 30;
+
+    SearchView(DatabaseHandler& db_handler);
+
+    sigc::signal<void>& signal_back_to_chat_list_requested() { return m_signal_back_to_chat_list_requested; }
+
+    // Emitted with room_id, room_name and message_id of the selected result
+    sigc::signal<void, std::string, std::string, std::string>& signal_open_search_result() {
+        return m_signal_open_search_result;
+    }
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef SHARD_MAP_H
+#define SHARD_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Places every room, with its messages, memberships and attachments, on one of the
+// shard databases by hashing its room_id. The hash is stable across builds and
+// platforms, but the shard count is not: changing it moves rooms between shards.
+class ShardMap {
+private:
+    std::vector<std::string> shard_conn_strs;
+
+public:
+    ShardMap() = default;
+    explicit ShardMap(std::vector<std::string> shard_conn_strs);
+
+    bool empty() const { return shard_conn_strs.empty(); }
+    std::size_t size() const { return shard_conn_strs.size(); }
+
+    std::size_t shard_for(const std::string& room_id) const;
+    const std::string& connection_string(std::size_t shard) const { return shard_conn_strs[shard]; }
+    const std::string& connection_string_for(const std::string& room_id) const;
+
+    // 64-bit FNV-1a
+    static std::uint64_t hash(const std::string& key);
+};
+
+#endif // SHARD_MAP_H
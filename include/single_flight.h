@@ -0,0 +1,56 @@
+#ifndef SINGLE_FLIGHT_H
+#define SINGLE_FLIGHT_H
+
+#include "query_metrics.h"
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+
+// Coalesces identical concurrent loads: while a load for a key is in flight, other
+// callers asking for the same key wait for it and share its result (or exception)
+// instead of running their own query. Nothing is cached once the load returns.
+template <typename Key, typename Value>
+class SingleFlight {
+private:
+    std::mutex mutex;
+    std::map<Key, std::shared_future<Value>> in_flight;
+
+public:
+    // Callers served by another caller's load are counted in stats.coalesced
+    Value run(const Key& key, OperationStats& stats, const std::function<Value()>& load) {
+        std::promise<Value> promise;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto running = in_flight.find(key);
+            if (running != in_flight.end()) {
+                std::shared_future<Value> result = running->second;
+                lock.unlock();
+                stats.coalesced.fetch_add(1, std::memory_order_relaxed);
+                return result.get();
+            }
+            in_flight.emplace(key, promise.get_future().share());
+        }
+
+        try {
+            Value value = load();
+            finish(key);
+            promise.set_value(value);
+            return value;
+        } catch (...) {
+            finish(key);
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+    }
+
+private:
+    // Later callers start a new load rather than getting a finished result
+    void finish(const Key& key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        in_flight.erase(key);
+    }
+};
+
+#endif // SINGLE_FLIGHT_H
@@ -0,0 +1,43 @@
+#ifndef STARTUP_MILESTONES_H
+#define STARTUP_MILESTONES_H
+
+#include <gtkmm/window.h>
+#include <chrono>
+#include <optional>
+
+// Time from the start of the process to the first frame of the main window, and to login
+// being ready (window shown and databases warmed up). Both are traced, a first frame later
+// than the target is reported like a main loop stall.
+class StartupMilestones {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::milliseconds FIRST_FRAME_TARGET{200};
+
+    // When the process was exec'd, so the libraries loaded before main count too
+    static Clock::time_point process_start_time();
+
+    explicit StartupMilestones(Clock::time_point process_start);
+    StartupMilestones(const StartupMilestones&) = delete;
+    StartupMilestones& operator=(const StartupMilestones&) = delete;
+    ~StartupMilestones();
+
+    // Must be called from the GTK main loop, once the window is realized
+    void watch(Gtk::Window& window);
+    void database_ready();
+
+private:
+    Clock::time_point process_start;
+    std::optional<Clock::time_point> first_frame;
+    bool database_warmed_up = false;
+    bool login_ready_recorded = false;
+
+    GdkFrameClock* frame_clock = nullptr;
+    gulong after_paint_id = 0;
+
+    static void on_after_paint(GdkFrameClock* clock, gpointer data);
+    void on_first_frame();
+    void record_login_ready();
+};
+
+#endif // STARTUP_MILESTONES_H
@@ -0,0 +1,50 @@
+#ifndef TEXT_SEARCH_H
+#define TEXT_SEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Append text to out with ASCII letters lower cased, other bytes (UTF-8 included) are kept as is
+void fold_ascii_case(std::string_view text, std::string& out);
+
+// Position of needle in haystack at or after from, npos when missing. Exact bytes, 16 positions
+// per step with SSE2 (first and last needle bytes compared at once), memchr otherwise.
+std::size_t find_bytes(std::string_view haystack, std::string_view needle, std::size_t from = 0);
+
+// Case-insensitive find over a room history, messages addressed like in MessageStore
+// (index 0 is the oldest). Contents are folded once when added and kept contiguous, so a
+// search is a single scan; the matches of the last search are kept and only messages
+// added since are scanned when it is repeated.
+class FindIndex {
+private:
+    // Folded contents, each followed by a '\0' so a match never spans two messages.
+    // Prepended messages have their own side, most recently prepended first.
+    struct Side {
+        std::string folded;
+        std::vector<std::size_t> starts;
+        std::size_t scanned = 0;              // entries already searched for the query
+        std::vector<std::size_t> matches;     // matching entries, ascending
+    };
+    Side older;
+    Side newer;
+    std::string query;
+
+    static void add(Side& side, std::string_view content);
+    void scan(Side& side);
+
+public:
+    void append(std::string_view content) { add(newer, content); }
+    void prepend(std::string_view content) { add(older, content); }
+
+    std::size_t size() const { return older.starts.size() + newer.starts.size(); }
+    std::size_t prepended_count() const { return older.starts.size(); }
+    std::size_t memory_size() const;
+
+    // Indexes of the messages containing text, ascending, ignoring ASCII case
+    std::vector<std::size_t> find(std::string_view text);
+};
+
+#endif // TEXT_SEARCH_H
@@ -0,0 +1,69 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Collects spans in memory and writes them as a Chrome/Perfetto trace (JSON)
+// Disabled by default, a disabled tracer only costs one atomic load per span.
+class Tracer {
+public:
+    using clock = std::chrono::steady_clock;
+
+    static Tracer& instance();
+
+    void enable(const std::string& output_path);
+    bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    void record_span(const std::string& name, const char* category,
+                     clock::time_point start, clock::time_point end);
+    void record_instant(const std::string& name, const char* category);
+
+    // Write the collected events to the output path
+    bool flush();
+
+private:
+    struct Event {
+        std::string name;
+        const char* category;
+        char phase;
+        std::int64_t timestamp_us;
+        std::int64_t duration_us;
+        std::uint32_t thread_id;
+    };
+
+    // Events past this limit are dropped to keep the memory bounded
+    static constexpr std::size_t MAX_EVENTS = 1000000;
+
+    Tracer();
+    void push(Event event);
+    static std::uint32_t current_thread_id();
+
+    std::atomic<bool> enabled{false};
+    std::mutex mutex;
+    std::vector<Event> events;
+    std::size_t dropped_events = 0;
+    std::string output_path;
+    clock::time_point origin;
+};
+
+// RAII span, recorded on destruction when tracing is enabled
+class TraceSpan {
+public:
+    explicit TraceSpan(std::string name, const char* category = "ui");
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+    ~TraceSpan();
+
+private:
+    std::string name;
+    const char* category;
+    bool active;
+    Tracer::clock::time_point start;
+};
+
+#endif // TRACER_H
@@ -0,0 +1,7 @@
+#!/bin/bash
+# init_replication.sh
+
+# Role and access rule used by the streaming replica (docker compose --profile replica)
+set -e
+psql -v ON_ERROR_STOP=1 --username "$POSTGRES_USER" -c "CREATE ROLE replicator WITH REPLICATION LOGIN PASSWORD 'replicator_password';"
+echo "host replication replicator all scram-sha-256" >> "$PGDATA/pg_hba.conf"
@@ -0,0 +1,233 @@
+-- init_shard.sql
+
+-- Schema of a room shard: rooms, their members, messages and attachments.
+-- Users and the room directory stay in the global database (init.sql).
+
+-- As super user during setup, create the vaoapp user
+CREATE USER vaoapp_user WITH PASSWORD 'vaoapp_user_password';
+
+-- Create the database
+CREATE DATABASE vaodb;
+\c vaodb
+
+-- Usernames of the members of the rooms on this shard, copied when a room is created
+CREATE TABLE users (
+    user_id VARCHAR(36) PRIMARY KEY,            -- UUID string, same as in the global database
+    username VARCHAR(50) NOT NULL               -- Username
+);
+
+-- Create the chat_rooms table
+CREATE TABLE chat_rooms (
+    room_id VARCHAR(36) PRIMARY KEY,            -- UUID string
+    room_name VARCHAR(101) NOT NULL,            -- Name of the chat room
+    created_at TIMESTAMP DEFAULT NOW()          -- Timestamp of room creation
+);
+
+-- Create the messages table, partitioned by month on timestamp so old months can be
+-- detached or dropped at once instead of deleted row by row
+CREATE TABLE messages (
+    message_id VARCHAR(36) NOT NULL,            -- UUID string
+    content TEXT NOT NULL,                      -- Message content
+    sender_id VARCHAR(36) NOT NULL,             -- Reference to the user who sent the message
+    room_id VARCHAR(36) NOT NULL,               -- Reference to the chat room where the message was sent
+    timestamp TIMESTAMP NOT NULL DEFAULT NOW(), -- Timestamp when the message was sent
+    is_read BOOLEAN DEFAULT FALSE,              -- Read status of the message
+    content_tsv TSVECTOR GENERATED ALWAYS AS (to_tsvector('english', content)) STORED, -- Search terms of the content
+    PRIMARY KEY (message_id, timestamp),        -- The partition key has to be part of the primary key
+    FOREIGN KEY (sender_id) REFERENCES users(user_id) ON DELETE CASCADE,
+    FOREIGN KEY (room_id) REFERENCES chat_rooms(room_id) ON DELETE CASCADE
+) PARTITION BY RANGE (timestamp);
+
+-- Rows outside of every monthly partition, moved to their month's partition once it is
+-- created (ensure_message_partitions)
+CREATE TABLE messages_default PARTITION OF messages DEFAULT;
+
+-- History of a room in order, also used to fetch only the messages after a known one
+CREATE INDEX messages_room_timestamp ON messages (room_id, timestamp, message_id);
+
+-- Full-text search over the message contents
+CREATE INDEX messages_content_tsv ON messages USING GIN (content_tsv);
+
+-- Monthly partitions (messages_YYYY_MM) from the current month to months_ahead months
+-- ahead, created when missing. Runs with the owner's rights so the app can call it.
+-- Rows written while their month had no partition (no app run for longer than
+-- months_ahead) are in the default partition, where they would make creating that
+-- partition fail: their months get a partition too, and the rows are moved into it.
+CREATE FUNCTION ensure_message_partitions(months_ahead INTEGER) RETURNS INTEGER
+LANGUAGE plpgsql SECURITY DEFINER SET search_path = public AS $$
+DECLARE
+    month_start TIMESTAMP;
+    partition_name TEXT;
+    created INTEGER := 0;
+BEGIN
+    -- Clients starting together would all find a month missing and all try to create it,
+    -- the next one in only checks once the first has committed
+    PERFORM pg_advisory_xact_lock(hashtext('ensure_message_partitions'));
+
+    FOR month_start IN
+        SELECT date_trunc('month', LOCALTIMESTAMP) + make_interval(months => i)
+        FROM generate_series(0, months_ahead) AS i
+        UNION
+        SELECT DISTINCT date_trunc('month', timestamp) FROM messages_default
+        ORDER BY 1
+    LOOP
+        partition_name := 'messages_' || to_char(month_start, 'YYYY_MM');
+        IF to_regclass(partition_name) IS NULL THEN
+            CREATE TEMP TABLE moved_messages ON COMMIT DROP AS
+                SELECT message_id, content, sender_id, room_id, timestamp, is_read
+                FROM messages_default
+                WHERE timestamp >= month_start AND timestamp < month_start + INTERVAL '1 month';
+            DELETE FROM messages_default
+            WHERE timestamp >= month_start AND timestamp < month_start + INTERVAL '1 month';
+
+            EXECUTE format('CREATE TABLE %I PARTITION OF messages FOR VALUES FROM (%L) TO (%L)',
+                           partition_name, month_start, month_start + INTERVAL '1 month');
+
+            INSERT INTO messages (message_id, content, sender_id, room_id, timestamp, is_read)
+            SELECT * FROM moved_messages;
+            DROP TABLE moved_messages;
+            created := created + 1;
+        END IF;
+    END LOOP;
+    RETURN created;
+END;
+$$;
+
+-- Detach the monthly partitions older than keep_months full months, a metadata only
+-- operation. Detached tables keep their name for archival, or are dropped. The attachments
+-- of their messages are removed either way, with the contents no other message uses.
+-- Run by the operator (tools/archive_messages.cpp), the app cannot call it.
+CREATE FUNCTION archive_message_partitions(keep_months INTEGER, drop_detached BOOLEAN) RETURNS SETOF TEXT
+LANGUAGE plpgsql SECURITY DEFINER SET search_path = public AS $$
+DECLARE
+    cutoff TIMESTAMP := date_trunc('month', LOCALTIMESTAMP) - make_interval(months => keep_months);
+    partition_name TEXT;
+    removed_sha256 TEXT[];
+BEGIN
+    FOR partition_name IN
+        SELECT c.relname
+        FROM pg_inherits i
+        JOIN pg_class c ON c.oid = i.inhrelid
+        WHERE i.inhparent = 'messages'::regclass
+        AND c.relname ~ '^messages_[0-9]{4}_[0-9]{2}$'
+        ORDER BY c.relname
+    LOOP
+        IF to_timestamp(substr(partition_name, 10), 'YYYY_MM')::timestamp + INTERVAL '1 month' <= cutoff THEN
+            EXECUTE format('ALTER TABLE messages DETACH PARTITION %I', partition_name);
+
+            EXECUTE format('WITH removed AS (
+                                DELETE FROM message_attachments ma USING %I m
+                                WHERE ma.message_id = m.message_id
+                                RETURNING ma.sha256
+                            )
+                            SELECT array_agg(DISTINCT sha256) FROM removed', partition_name)
+                INTO removed_sha256;
+            DELETE FROM attachments a
+            WHERE a.sha256 = ANY(removed_sha256)
+            AND NOT EXISTS (SELECT 1 FROM message_attachments ma WHERE ma.sha256 = a.sha256);
+
+            IF drop_detached THEN
+                EXECUTE format('DROP TABLE %I', partition_name);
+            END IF;
+            RETURN NEXT partition_name;
+        END IF;
+    END LOOP;
+END;
+$$;
+
+REVOKE EXECUTE ON FUNCTION archive_message_partitions(INTEGER, BOOLEAN) FROM PUBLIC;
+
+SELECT ensure_message_partitions(3);
+
+-- Create the chat_room_members table to manage the many-to-many relationship
+CREATE TABLE chat_room_members (
+    room_id VARCHAR(36) NOT NULL,               -- Reference to chat room
+    user_id VARCHAR(36) NOT NULL,               -- Reference to user
+    PRIMARY KEY (room_id, user_id),             -- Composite primary key
+    FOREIGN KEY (room_id) REFERENCES chat_rooms(room_id) ON DELETE CASCADE,
+    FOREIGN KEY (user_id) REFERENCES users(user_id) ON DELETE CASCADE
+);
+
+-- Lists the rooms of a user on this shard
+CREATE INDEX chat_room_members_user ON chat_room_members (user_id);
+
+-- Tell the clients caching a room (RoomChangeListener) that its name or members changed,
+-- the payload is the room_id. Notifications are only delivered on commit, once per
+-- distinct room per transaction however many members were added.
+CREATE FUNCTION notify_room_changed() RETURNS TRIGGER
+LANGUAGE plpgsql AS $$
+BEGIN
+    IF TG_TABLE_NAME = 'users' THEN
+        PERFORM pg_notify('room_changed', room_id) FROM chat_room_members WHERE user_id = NEW.user_id;
+    ELSIF TG_OP = 'DELETE' THEN
+        PERFORM pg_notify('room_changed', OLD.room_id);
+    ELSE
+        PERFORM pg_notify('room_changed', NEW.room_id);
+    END IF;
+    RETURN NULL;
+END;
+$$;
+
+CREATE TRIGGER chat_room_members_changed AFTER INSERT OR UPDATE OR DELETE ON chat_room_members
+    FOR EACH ROW EXECUTE FUNCTION notify_room_changed();
+CREATE TRIGGER chat_rooms_renamed AFTER UPDATE OF room_name ON chat_rooms
+    FOR EACH ROW EXECUTE FUNCTION notify_room_changed();
+CREATE TRIGGER users_renamed AFTER UPDATE OF username ON users
+    FOR EACH ROW EXECUTE FUNCTION notify_room_changed();
+
+-- Undo a room created on this shard whose room_directory rows could not be committed on
+-- the main database, its members go with it (ON DELETE CASCADE). Runs with the owner's
+-- rights since the app cannot delete rooms, and only deletes a room nobody wrote in yet.
+CREATE FUNCTION delete_unlisted_room(unlisted_room_id VARCHAR(36)) RETURNS BOOLEAN
+LANGUAGE plpgsql SECURITY DEFINER SET search_path = public AS $$
+BEGIN
+    DELETE FROM chat_rooms r
+    WHERE r.room_id = unlisted_room_id
+    AND NOT EXISTS (SELECT 1 FROM messages m WHERE m.room_id = unlisted_room_id);
+    RETURN FOUND;
+END;
+$$;
+
+-- Attachment contents, stored once per distinct SHA-256 on each shard
+CREATE TABLE attachments (
+    sha256 CHAR(64) PRIMARY KEY,                -- Hex SHA-256 of the content
+    size_bytes BIGINT NOT NULL,                 -- Size of the content
+    chunk_size INTEGER NOT NULL,                -- Size of every chunk but the last
+    chunk_count INTEGER NOT NULL,               -- Number of chunks
+    created_at TIMESTAMP DEFAULT NOW()          -- Timestamp of the first upload
+);
+
+-- Attachment contents split in fixed size chunks, streamed one at a time
+CREATE TABLE attachment_chunks (
+    sha256 CHAR(64) NOT NULL,                   -- Reference to the attachment
+    chunk_index INTEGER NOT NULL,               -- Position of the chunk
+    data BYTEA NOT NULL,                        -- Chunk content
+    PRIMARY KEY (sha256, chunk_index),
+    FOREIGN KEY (sha256) REFERENCES attachments(sha256) ON DELETE CASCADE
+);
+
+-- Files attached to messages, the message content holds the file name
+CREATE TABLE message_attachments (
+    message_id VARCHAR(36) PRIMARY KEY,         -- Reference to the message
+    room_id VARCHAR(36) NOT NULL,               -- Room of the message, to list a room without joining messages
+    sha256 CHAR(64) NOT NULL,                   -- Reference to the content
+    file_name VARCHAR(255) NOT NULL,            -- Original file name
+    FOREIGN KEY (sha256) REFERENCES attachments(sha256)   -- messages(message_id) is not unique on its own once partitioned
+);
+CREATE INDEX message_attachments_room ON message_attachments (room_id);
+
+-- Whether a content is still attached to a message, once archiving removed some
+CREATE INDEX message_attachments_sha256 ON message_attachments (sha256);
+
+-- Grant rights to the vaoapp_user
+GRANT CONNECT ON DATABASE vaodb TO vaoapp_user;
+GRANT USAGE ON SCHEMA public TO vaoapp_user;
+GRANT SELECT, INSERT, UPDATE ON users TO vaoapp_user;
+GRANT SELECT, INSERT, UPDATE ON messages TO vaoapp_user;
+GRANT SELECT, INSERT, UPDATE ON chat_rooms TO vaoapp_user;
+GRANT SELECT, INSERT, UPDATE ON chat_room_members TO vaoapp_user;
+GRANT SELECT, INSERT ON attachments TO vaoapp_user;
+GRANT SELECT, INSERT ON attachment_chunks TO vaoapp_user;
+GRANT SELECT, INSERT ON message_attachments TO vaoapp_user;
+GRANT EXECUTE ON FUNCTION ensure_message_partitions(INTEGER) TO vaoapp_user;
+GRANT EXECUTE ON FUNCTION delete_unlisted_room(VARCHAR) TO vaoapp_user;
@@ -1,16 +1,124 @@
 #include <gtkmm/application.h>
+#include <glib-unix.h>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
 #include "main_window.h"
 #include "database_handler.h"
+#include "main_loop_watchdog.h"
+#include "background_worker.h"
+#include "startup_milestones.h"
+#include "tracer.h"
+
+// Dump the query metrics on SIGUSR1, runs on the GTK main loop
+static gboolean on_dump_metrics_signal(gpointer user_data) {
+    auto db_handler = static_cast<DatabaseHandler*>(user_data);
+    const char* path = std::getenv("VAOAPP_METRICS_FILE");
+    std::string metrics_path = path ? path : "vaoapp_metrics.prom";
+    if (!db_handler->getMetrics().write_prometheus_file(metrics_path)) {
+        std::cerr << "Could not write metrics to " << metrics_path << std::endl;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+// Consume our own flags (--trace=<file>, --frame-budget=<ms>) before GTK parses argv
+static void parse_app_flags(int& argc, char* argv[], std::string& trace_path, int& frame_budget_ms) {
+    int kept = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--trace=", 8) == 0) {
+            trace_path = argv[i] + 8;
+        } else if (std::strncmp(argv[i], "--frame-budget=", 15) == 0) {
+            frame_budget_ms = std::atoi(argv[i] + 15);
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+}
+
+// VAOAPP_STATEMENT_TIMEOUTS="open_room=2000,stream_room_messages=0" overrides the
+// per operation statement timeouts, in milliseconds (0 disables one)
+static void configure_statement_timeouts(DatabaseHandler& db_handler) {
+    const char* setting = std::getenv("VAOAPP_STATEMENT_TIMEOUTS");
+    if (!setting) return;
+
+    std::stringstream entries(setting);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        auto separator = entry.find('=');
+        if (separator == std::string::npos) continue;
+        db_handler.set_statement_timeout(entry.substr(0, separator),
+                                         std::chrono::milliseconds(std::atol(entry.c_str() + separator + 1)));
+    }
+}
+
+// Connection strings separated by ';' in an environment variable
+// (VAOAPP_DB_REPLICAS for the read replicas, VAOAPP_DB_SHARDS for the room shards)
+static std::vector<std::string> connection_strings_from_env(const char* name) {
+    std::vector<std::string> conn_strs;
+    const char* setting = std::getenv(name);
+    if (!setting) return conn_strs;
+
+    std::stringstream entries(setting);
+    std::string entry;
+    while (std::getline(entries, entry, ';')) {
+        if (!entry.empty()) conn_strs.push_back(entry);
+    }
+    return conn_strs;
+}
+
+// Create the next months of messages partitions
+static void maintain_message_partitions(DatabaseHandler& db_handler) {
+    try {
+        db_handler.maintain_message_partitions(3);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
 
 int main(int argc, char* argv[]) {
+    auto process_start = StartupMilestones::process_start_time();
+
+    // Tracing and stall detection flags
+    std::string trace_path;
+    int frame_budget_ms = 50;
+    parse_app_flags(argc, argv, trace_path, frame_budget_ms);
+    if (trace_path.empty() && std::getenv("VAOAPP_TRACE_FILE")) {
+        trace_path = std::getenv("VAOAPP_TRACE_FILE");
+    }
+    if (!trace_path.empty()) {
+        Tracer::instance().enable(trace_path);
+    }
 
     // App and credentials creation
     auto app = Gtk::Application::create(argc, argv, "org.vaoapp");
     std::string conn_str = "host=localhost port=5432 dbname=vaodb user=vaoapp_user password=vaoapp_user_password";
+    if (std::getenv("VAOAPP_DB")) conn_str = std::getenv("VAOAPP_DB");
+
+    // Database connection, writes go to conn_str and reads to the replicas,
+    // with shards conn_str only holds the users and the room directory
+    DatabaseHandler db_handler(conn_str, connection_strings_from_env("VAOAPP_DB_REPLICAS"),
+                               connection_strings_from_env("VAOAPP_DB_SHARDS"));
+    configure_statement_timeouts(db_handler);
 
-    // Start the window and database connection
-    DatabaseHandler db_handler(conn_str);
+    // The databases are connected to while the window is built and shown, then the
+    // messages partitions are kept up, off the main loop
+    StartupMilestones startup(process_start);
+    BackgroundWorker startup_worker;
+    startup_worker.post([&db_handler]() { db_handler.warm_up(); }, [&startup]() { startup.database_ready(); });
+    startup_worker.post([&db_handler]() { maintain_message_partitions(db_handler); });
+
+    // Only the login view is built up front, the other views on first use
     MainWindow window(db_handler);
-    
-    return app->run(window);
-}
\ No newline at end of file
+    startup.watch(window);
+    MainLoopWatchdog watchdog(std::chrono::milliseconds(frame_budget_ms > 0 ? frame_budget_ms : 50));
+
+    // kill -USR1 <pid> writes the metrics, they are also written on exit
+    g_unix_signal_add(SIGUSR1, on_dump_metrics_signal, &db_handler);
+
+    int status = app->run(window);
+    on_dump_metrics_signal(&db_handler);
+    Tracer::instance().flush();
+    return status;
+}
@@ -0,0 +1,242 @@
+#include "attachment_store.h"
+#include <openssl/evp.h>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+namespace {
+
+std::string to_hex(const unsigned char* digest, unsigned int length) {
+    std::ostringstream oss;
+    for (unsigned int i = 0; i < length; ++i) {
+        oss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(digest[i]);
+    }
+    return oss.str();
+}
+
+// Incremental SHA-256
+class Sha256 {
+private:
+    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> context{EVP_MD_CTX_new(), &EVP_MD_CTX_free};
+
+public:
+    Sha256() {
+        if (!context || EVP_DigestInit_ex(context.get(), EVP_sha256(), nullptr) != 1) {
+            throw std::runtime_error("Could not initialize SHA-256");
+        }
+    }
+
+    void update(const char* data, std::size_t size) {
+        EVP_DigestUpdate(context.get(), data, size);
+    }
+
+    std::string hex_digest() {
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int length = 0;
+        EVP_DigestFinal_ex(context.get(), digest, &length);
+        return to_hex(digest, length);
+    }
+};
+
+std::string base_name(const std::string& path) {
+    auto slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+} // namespace
+
+AttachmentStore::AttachmentStore(DatabaseHandler& db) : db_handler(db) {
+}
+
+// First pass over the file: content hash and size, to find out whether the content is
+// already stored before sending any of it
+std::string AttachmentStore::hash_file(const std::string& path, std::int64_t& size_bytes) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error("Cannot open " + path);
+
+    Sha256 sha;
+    std::vector<char> buffer(CHUNK_SIZE);
+    size_bytes = 0;
+    while (file) {
+        file.read(buffer.data(), buffer.size());
+        std::streamsize read = file.gcount();
+        if (read <= 0) break;
+        sha.update(buffer.data(), static_cast<std::size_t>(read));
+        size_bytes += read;
+    }
+    return sha.hex_digest();
+}
+
+// Store the file content unless the same content is already there, returns its hash
+std::string AttachmentStore::upload(const std::string& room_id, const std::string& path, std::int64_t& size_bytes) {
+    QueryMetrics::Scope op(db_handler.getMetrics().operation("upload_attachment"));
+    try {
+        std::string sha256 = hash_file(path, size_bytes);
+        auto chunk_count = static_cast<int>((size_bytes + CHUNK_SIZE - 1) / CHUNK_SIZE);
+
+        PooledConnection dbConnection = db_handler.createRoomConnection(room_id, "upload_attachment");
+        pqxx::work txn(dbConnection);
+
+        // A concurrent upload of the same content waits on the primary key, then finds it
+        pqxx::result claimed = txn.exec_params(
+            "INSERT INTO attachments (sha256, size_bytes, chunk_size, chunk_count) "
+            "VALUES ($1, $2, $3, $4) ON CONFLICT (sha256) DO NOTHING;",
+            sha256, size_bytes, static_cast<int>(CHUNK_SIZE), chunk_count
+        );
+        if (claimed.affected_rows() == 0) {
+            txn.commit();
+            return sha256;
+        }
+
+        // Second pass: send the chunks one by one, hashing the bytes actually sent. A file
+        // changed since the first pass rolls everything back, the content would otherwise be
+        // stored under a hash it does not have and served to every later upload of that hash.
+        std::ifstream file(path, std::ios::binary);
+        if (!file) throw std::runtime_error("Cannot open " + path);
+
+        Sha256 sent;
+        std::int64_t sent_bytes = 0;
+        std::vector<char> buffer(CHUNK_SIZE);
+        for (int chunk_index = 0; chunk_index < chunk_count; ++chunk_index) {
+            file.read(buffer.data(), buffer.size());
+            std::streamsize read = file.gcount();
+            if (read <= 0) throw std::runtime_error("File changed while uploading");
+            sent.update(buffer.data(), static_cast<std::size_t>(read));
+            sent_bytes += read;
+
+            pqxx::binarystring chunk(buffer.data(), static_cast<std::size_t>(read));
+            txn.exec_params(
+                "INSERT INTO attachment_chunks (sha256, chunk_index, data) VALUES ($1, $2, $3);",
+                sha256, chunk_index, chunk
+            );
+            op.rows(1);
+        }
+
+        // Also catches a file grown past the size of the first pass
+        if (file.peek() != std::ifstream::traits_type::eof() || sent_bytes != size_bytes
+            || sent.hex_digest() != sha256) {
+            throw std::runtime_error("File changed while uploading");
+        }
+
+        txn.commit();
+        return sha256;
+
+    } catch (const std::exception& e) {
+        op.fail();
+        throw std::runtime_error("Failed to upload attachment: " + std::string(e.what()));
+    }
+}
+
+AttachmentInfo AttachmentStore::send_attachment(const std::string& room_id, const std::string& sender_id, const std::string& path) {
+    AttachmentInfo attachment;
+    attachment.room_id = room_id;
+    attachment.file_name = base_name(path);
+    attachment.sha256 = upload(room_id, path, attachment.size_bytes);
+
+    QueryMetrics::Scope op(db_handler.getMetrics().operation("send_attachment"));
+    try {
+        PooledConnection dbConnection = db_handler.createRoomConnection(room_id, "send_attachment");
+        pqxx::work txn(dbConnection);
+
+        // Generate a unique message ID
+        uuid_t uuid;
+        char uuid_str[37];
+        uuid_generate_random(uuid);
+        uuid_unparse_lower(uuid, uuid_str);
+        attachment.message_id = std::string(uuid_str);
+
+        // The message row only carries the file name, the bytes stay in the attachment tables
+        txn.exec_params(
+            "INSERT INTO messages (message_id, content, sender_id, room_id) VALUES ($1, $2, $3, $4);",
+            attachment.message_id, attachment.file_name, sender_id, room_id
+        );
+        txn.exec_params(
+            "INSERT INTO message_attachments (message_id, room_id, sha256, file_name) VALUES ($1, $2, $3, $4);",
+            attachment.message_id, room_id, attachment.sha256, attachment.file_name
+        );
+        txn.commit();
+
+    } catch (const std::exception& e) {
+        op.fail();
+        throw std::runtime_error("Failed to send attachment: " + std::string(e.what()));
+    }
+
+    return attachment;
+}
+
+std::map<std::string, AttachmentInfo, std::less<>> AttachmentStore::get_room_attachments(const std::string& room_id) {
+    std::map<std::string, AttachmentInfo, std::less<>> attachments;
+    QueryMetrics::Scope op(db_handler.getMetrics().operation("get_room_attachments"));
+    try {
+        PooledConnection dbConnection = db_handler.createRoomConnection(room_id, "get_room_attachments");
+        pqxx::work txn(dbConnection);
+
+        std::string query = R"(
+            SELECT ma.message_id, ma.sha256, ma.file_name, a.size_bytes
+            FROM message_attachments ma
+            INNER JOIN attachments a ON a.sha256 = ma.sha256
+            WHERE ma.room_id = $1;
+        )";
+
+        pqxx::result result = txn.exec_params(query, room_id);
+        op.rows(result.size());
+        for (const auto& row : result) {
+            AttachmentInfo attachment;
+            attachment.message_id = row["message_id"].as<std::string>();
+            attachment.room_id = room_id;
+            attachment.sha256 = row["sha256"].as<std::string>();
+            attachment.file_name = row["file_name"].as<std::string>();
+            attachment.size_bytes = row["size_bytes"].as<std::int64_t>();
+            attachments.emplace(attachment.message_id, attachment);
+        }
+        txn.commit();
+
+    } catch (const std::exception& e) {
+        op.fail();
+        throw std::runtime_error("Failed to get room attachments: " + std::string(e.what()));
+    }
+
+    return attachments;
+}
+
+void AttachmentStore::download(const AttachmentInfo& attachment, const std::string& output_path) {
+    QueryMetrics::Scope op(db_handler.getMetrics().operation("download_attachment"));
+    try {
+        PooledConnection dbConnection = db_handler.createRoomConnection(attachment.room_id, "download_attachment");
+        pqxx::read_transaction txn(dbConnection);
+
+        pqxx::result header = txn.exec_params(
+            "SELECT chunk_count FROM attachments WHERE sha256 = $1;", attachment.sha256
+        );
+        if (header.empty()) throw std::runtime_error("Attachment not found");
+        int chunk_count = header[0][0].as<int>();
+
+        std::ofstream file(output_path, std::ios::binary | std::ios::trunc);
+        if (!file) throw std::runtime_error("Cannot write " + output_path);
+
+        // One chunk in memory at a time, checked against the content hash at the end
+        Sha256 sha;
+        for (int chunk_index = 0; chunk_index < chunk_count; ++chunk_index) {
+            pqxx::result chunk = txn.exec_params(
+                "SELECT data FROM attachment_chunks WHERE sha256 = $1 AND chunk_index = $2;",
+                attachment.sha256, chunk_index
+            );
+            if (chunk.empty()) throw std::runtime_error("Missing chunk " + std::to_string(chunk_index));
+
+            pqxx::binarystring data(chunk[0][0]);
+            const char* bytes = reinterpret_cast<const char*>(data.data());
+            sha.update(bytes, data.size());
+            file.write(bytes, static_cast<std::streamsize>(data.size()));
+            op.rows(1);
+        }
+
+        if (sha.hex_digest() != attachment.sha256) {
+            throw std::runtime_error("Content does not match its hash");
+        }
+        if (!file.flush()) throw std::runtime_error("Cannot write " + output_path);
+
+    } catch (const std::exception& e) {
+        op.fail();
+        throw std::runtime_error("Failed to download attachment: " + std::string(e.what()));
+    }
+}
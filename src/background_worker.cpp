@@ -0,0 +1,64 @@
+#include "background_worker.h"
+#include <iostream>
+
+BackgroundWorker::BackgroundWorker() {
+    dispatcher.connect(sigc::mem_fun(*this, &BackgroundWorker::on_dispatch));
+    thread = std::thread(&BackgroundWorker::run, this);
+}
+
+BackgroundWorker::~BackgroundWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        tasks.clear();
+    }
+    wake_up.notify_one();
+    thread.join();
+}
+
+void BackgroundWorker::post(std::function<void()> work, std::function<void()> done) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back({std::move(work), std::move(done)});
+    }
+    wake_up.notify_one();
+}
+
+void BackgroundWorker::post_to_main_loop(std::function<void()> callback) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) return;
+        main_loop_callbacks.push_back(std::move(callback));
+    }
+    dispatcher.emit();
+}
+
+void BackgroundWorker::run() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake_up.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (stopping) return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+
+        try {
+            task.work();
+        } catch (const std::exception& e) {
+            std::cerr << "Background task failed: " << e.what() << std::endl;
+        }
+        if (task.done) post_to_main_loop(std::move(task.done));
+    }
+}
+
+void BackgroundWorker::on_dispatch() {
+    // Run everything queued so far, a single emit may stand for several callbacks
+    std::deque<std::function<void()>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        callbacks.swap(main_loop_callbacks);
+    }
+    for (auto& callback : callbacks) callback();
+}
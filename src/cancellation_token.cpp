@@ -0,0 +1,41 @@
+#include "cancellation_token.h"
+
+#include <iostream>
+
+void CancellationToken::cancel() {
+    cancelled.store(true);
+
+    // The lock keeps the connection alive until the cancel request is sent
+    std::lock_guard<std::mutex> lock(mutex);
+    if (connection) {
+        try {
+            cancel_sent = true;
+            connection->cancel_query();
+        } catch (const std::exception& e) {
+            std::cerr << "Could not cancel query: " << e.what() << std::endl;
+        }
+    }
+}
+
+void CancellationToken::throw_if_cancelled() const {
+    if (is_cancelled()) throw OperationCancelled();
+}
+
+// Binding
+CancellationToken::Binding::Binding(CancellationToken* token, PooledConnection& connection)
+    : token(token), connection(connection) {
+    if (!token) return;
+    std::lock_guard<std::mutex> lock(token->mutex);
+    if (token->is_cancelled()) throw OperationCancelled();
+    token->connection = &*connection;
+    token->cancel_sent = false;
+}
+
+// Under the lock no cancel request can reach the connection once it is unbound
+CancellationToken::Binding::~Binding() {
+    if (!token) return;
+    std::lock_guard<std::mutex> lock(token->mutex);
+    token->connection = nullptr;
+    if (token->cancel_sent) connection.discard();
+    token->cancel_sent = false;
+}
@@ -27,17 +27,22 @@ ChatListView::ChatListView(DatabaseHandler& db)
     chat_list.set_margin_start(5);
     chat_list.set_margin_end(5);
     
-    // Connect the row-activated signal
+    // Connect the row-activated signal, it already covers clicks and the keyboard
     chat_list.signal_row_activated().connect(
         sigc::mem_fun(*this, &ChatListView::on_chat_row_activated)
     );
 
-    // Double-click with left button event
-    chat_list.add_events(Gdk::BUTTON_PRESS_MASK);
-    chat_list.signal_button_press_event().connect(
-        sigc::mem_fun(*this, &ChatListView::on_button_press_event),
-        false
+    // Hovered and selected rows are likely to be opened next
+    chat_list.add_events(Gdk::POINTER_MOTION_MASK);
+    chat_list.signal_motion_notify_event().connect(
+        sigc::mem_fun(*this, &ChatListView::on_motion_notify_event)
     );
+    chat_list.signal_row_selected().connect(
+        sigc::mem_fun(*this, &ChatListView::on_row_selected)
+    );
+
+    // Most recently active rooms first
+    chat_list.set_sort_func(sigc::mem_fun(*this, &ChatListView::compare_rows));
 
     // Create button box
     auto button_box = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_HORIZONTAL, 10));
@@ -52,6 +57,11 @@ ChatListView::ChatListView(DatabaseHandler& db)
         sigc::mem_fun(*this, &ChatListView::on_new_chat_room_clicked)
     );
 
+    // Setup search button
+    search_button.set_label("Search");
+    search_button.set_size_request(-1, 40);
+    search_button.signal_clicked().connect([this]() { m_signal_search_requested.emit(); });
+
     // Setup logout button
     logout_button.set_label("Logout");
     logout_button.get_style_context()->add_class("destructive-action");
@@ -62,6 +72,7 @@ ChatListView::ChatListView(DatabaseHandler& db)
 
     // Pack buttons into button box
     button_box->pack_start(new_chat_button, true, true, 0);
+    button_box->pack_start(search_button, true, true, 0);
     button_box->pack_start(logout_button, true, true, 0);
     
     // Set margins for main container
@@ -80,16 +91,28 @@ ChatListView::ChatListView(DatabaseHandler& db)
     show_all();
 }
 
-bool ChatListView::on_button_press_event(GdkEventButton* event) {
-    if (event->type == GDK_2BUTTON_PRESS && event->button == 1) {  // Double-click with left button
-        // Get the row at the clicked position
-        Gtk::ListBoxRow* row = chat_list.get_row_at_y(event->y);
-        if (row) {
-            on_chat_row_activated(row);
-            return true;  // Event handled
-        }
+ChatListView::~ChatListView() {
+    if (update_tick_id) remove_tick_callback(update_tick_id);
+}
+
+bool ChatListView::on_motion_notify_event(GdkEventMotion* event) {
+    Gtk::ListBoxRow* row = chat_list.get_row_at_y(static_cast<int>(event->y));
+    if (row && row != hovered_row) {
+        hovered_row = row;
+        emit_room_hovered(row);
+    }
+    return false;
+}
+
+void ChatListView::on_row_selected(Gtk::ListBoxRow* row) {
+    if (row) emit_room_hovered(row);
+}
+
+void ChatListView::emit_room_hovered(Gtk::ListBoxRow* row) {
+    auto room_id_ptr = static_cast<std::string*>(row->get_data("room_id"));
+    if (room_id_ptr) {
+        m_signal_room_hovered.emit(*room_id_ptr);
     }
-    return false;  // Event not handled
 }
 
 void ChatListView::on_chat_row_activated(Gtk::ListBoxRow* row) {
@@ -110,8 +133,11 @@ void ChatListView::on_new_chat_room_clicked() {
 }
 
 void ChatListView::load_conversations() {
+    TraceSpan span("ChatListView::load_conversations");
     try {
         // Clear existing rows
+        hovered_row = nullptr;
+        presence_labels.clear();
         auto children = chat_list.get_children();
         for (auto* child : children) {
             // Clean up stored data
@@ -122,25 +148,14 @@ void ChatListView::load_conversations() {
             chat_list.remove(*child);
         }
 
-        // Load conversations from database
+        // Load conversations from database, they come newest first
         auto conversations = db_handler.get_user_conversations(current_user->getUserId());
+        room_ranks.clear();
+        last_rank = conversations.size();
+        std::uint64_t rank = last_rank;
         for (const auto& [room_id, room_name] : conversations) {
-
-            auto row = Gtk::manage(new Gtk::ListBoxRow());
-            auto box = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_HORIZONTAL, 5));
-
-            auto label = Gtk::manage(new Gtk::Label(room_name));
-            label->set_halign(Gtk::ALIGN_START);
-            
-            // Pack widgets
-            box->pack_start(*label, true, true, 5);
-            row->add(*box);
-            
-            row->set_data("room_id", new std::string(room_id));
-            row->set_data("room_name", new std::string(room_name));
-            
-            row->show_all();
-            chat_list.append(*row);
+            room_ranks[room_id] = rank--;
+            append_room_row(room_id, room_name);
         }
         
         show_all();
@@ -150,6 +165,77 @@ void ChatListView::load_conversations() {
     }
 }
 
+void ChatListView::append_room_row(const std::string& room_id, const std::string& room_name) {
+    auto row = Gtk::manage(new Gtk::ListBoxRow());
+    auto box = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_HORIZONTAL, 5));
+
+    auto label = Gtk::manage(new Gtk::Label(room_name));
+    label->set_halign(Gtk::ALIGN_START);
+    
+    auto presence_label = Gtk::manage(new Gtk::Label());
+    presence_label->get_style_context()->add_class("dim-label");
+    presence_labels[room_id] = presence_label;
+
+    // Pack widgets
+    box->pack_start(*label, true, true, 5);
+    box->pack_end(*presence_label, false, false, 5);
+    row->add(*box);
+    
+    row->set_data("room_id", new std::string(room_id));
+    row->set_data("room_name", new std::string(room_name));
+    
+    row->show_all();
+    chat_list.append(*row);
+}
+
+int ChatListView::compare_rows(Gtk::ListBoxRow* first, Gtk::ListBoxRow* second) {
+    auto rank_of = [this](Gtk::ListBoxRow* row) -> std::uint64_t {
+        auto room_id_ptr = static_cast<std::string*>(row->get_data("room_id"));
+        if (!room_id_ptr) return 0;
+        auto rank = room_ranks.find(*room_id_ptr);
+        return rank != room_ranks.end() ? rank->second : 0;
+    };
+    std::uint64_t first_rank = rank_of(first);
+    std::uint64_t second_rank = rank_of(second);
+    return first_rank > second_rank ? -1 : (first_rank < second_rank ? 1 : 0);
+}
+
+void ChatListView::queue_room_activity(const std::string& room_id, const std::string& room_name) {
+    pending_activity.emplace_back(room_id, room_name);
+    if (update_tick_id == 0) {
+        update_tick_id = add_tick_callback(sigc::mem_fun(*this, &ChatListView::on_update_tick));
+    }
+}
+
+// Apply the collected activity with a single resort of the list
+bool ChatListView::on_update_tick(const Glib::RefPtr<Gdk::FrameClock>&) {
+    TraceSpan span("ChatListView::apply_updates");
+    update_tick_id = 0;
+    for (const auto& [room_id, room_name] : pending_activity) {
+        bool is_new = room_ranks.find(room_id) == room_ranks.end();
+        room_ranks[room_id] = ++last_rank;
+        if (is_new) append_room_row(room_id, room_name);
+    }
+    pending_activity.clear();
+    chat_list.invalidate_sort();
+    return false;
+}
+
+void ChatListView::show_presence(const PresenceSnapshot& presence) {
+    for (auto& [room_id, label] : presence_labels) {
+        auto room = presence.find(room_id);
+        if (room == presence.end()) {
+            label->set_text("");
+        } else if (!room->second.typing_user_ids.empty()) {
+            label->set_text("typing...");
+        } else if (!room->second.online_user_ids.empty()) {
+            label->set_text(std::to_string(room->second.online_user_ids.size()) + " online");
+        } else {
+            label->set_text("");
+        }
+    }
+}
+
 void ChatListView::on_logout_clicked(){
     m_signal_logout.emit();
 }
\ No newline at end of file
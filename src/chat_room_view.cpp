@@ -1,11 +1,41 @@
 #include "chat_room_view.h"
+#include <set>
+
+// Copy a page of messages (oldest first) into a store chunk
+static MessageStore to_message_store(const std::vector<Message>& messages, const std::string& room_id) {
+    MessageStore chunk;
+    for (const auto& msg : messages) {
+        chunk.append(msg.message_id, msg.content, msg.sender_id, room_id,
+                     std::chrono::system_clock::to_time_t(msg.timestamp), msg.is_read);
+    }
+    return chunk;
+}
+
+// Distinct senders of a page or chunk, their usernames are read before it is displayed
+static std::vector<std::string> sender_ids(const std::vector<Message>& messages) {
+    std::set<std::string> ids;
+    for (const auto& msg : messages) ids.insert(msg.sender_id);
+    return std::vector<std::string>(ids.begin(), ids.end());
+}
+
+static std::vector<std::string> sender_ids(const MessageStore& chunk) {
+    std::set<std::string, std::less<>> ids;
+    for (std::size_t i = 0; i < chunk.size(); ++i) {
+        std::string_view sender_id = chunk.sender_id(chunk[i]);
+        if (ids.find(sender_id) == ids.end()) ids.emplace(sender_id);
+    }
+    return std::vector<std::string>(ids.begin(), ids.end());
+}
 
 // Constructor
-ChatRoomView::ChatRoomView(DatabaseHandler& db_handler, const std::string& room_id, const std::string& room_name)
+ChatRoomView::ChatRoomView(DatabaseHandler& db_handler, const std::string& room_id, const std::string& room_name,
+                           std::optional<RoomSnapshot> snapshot, const std::string& anchor_message_id)
     : Gtk::Box(),
       db_handler(db_handler),
       room_id(room_id),
-      room_name(room_name)
+      room_name(room_name),
+      anchor_message_id(anchor_message_id),
+      attachment_store(db_handler)
 {
    // Initialize components
     main_box = Gtk::Box(Gtk::ORIENTATION_VERTICAL, 10);
@@ -13,8 +43,11 @@ ChatRoomView::ChatRoomView(DatabaseHandler& db_handler, const std::string& room_
     input_box = Gtk::Box(Gtk::ORIENTATION_HORIZONTAL, 5);
     send_button = Gtk::Button("Send");
     go_back_button = Gtk::Button("Go Back");
+    attach_button = Gtk::Button("Attach");
 
     current_user = db_handler.getCurrentUser();
+    usernames.emplace(current_user->getUserId(), current_user->getUsername());
+    resolved_sender_ids.insert(current_user->getUserId());
 
     set_halign(Gtk::ALIGN_CENTER); // Center horizontally
     set_valign(Gtk::ALIGN_CENTER); // Center vertically
@@ -25,35 +58,112 @@ ChatRoomView::ChatRoomView(DatabaseHandler& db_handler, const std::string& room_
     room_label.get_style_context()->add_class("title-2");
     room_label.set_margin_bottom(5);
 
-    // Add users list label
+    // Add users list label, a summary of the members (count and first names)
     users_label = Gtk::manage(new Gtk::Label());
-    try {
-        auto room_users = db_handler.get_room_users(room_id);
-        std::string users_text = "with ";
-        for (size_t i = 0; i < room_users.size(); ++i) {
-            users_text += room_users[i];
-            if (i < room_users.size() - 2) users_text += ", ";
-            else if (i == room_users.size() - 2) users_text += " and ";
-        }
-        users_label->set_text(users_text);
-    } catch (const std::exception& e) {
-        users_label->set_text("with unknown users");
+    // Without a snapshot the members arrive with the first page of messages
+    if (snapshot && snapshot->members) {
+        show_room_info(RoomInfo{snapshot->room_name, *snapshot->members});
     }
     users_label->set_halign(Gtk::ALIGN_START);
     users_label->get_style_context()->add_class("subtitle-1");
-    users_label->set_margin_bottom(10);
+    users_box = Gtk::Box(Gtk::ORIENTATION_HORIZONTAL, 10);
+    users_box.set_margin_bottom(10);
+    users_box.pack_start(*users_label, false, false, 0);
+    users_box.pack_start(members_button, false, false, 0);
+    presence_label.set_halign(Gtk::ALIGN_START);
+    presence_label.get_style_context()->add_class("dim-label");
+
+    // Member browser, the full list is only read page by page once it is opened
+    members_button.set_label("Members");
+    members_button.set_popover(members_popover);
+    members_scroll.set_policy(Gtk::POLICY_NEVER, Gtk::POLICY_AUTOMATIC);
+    members_scroll.set_size_request(250, 300);
+    members_scroll.add(members_list);
+    members_list.set_selection_mode(Gtk::SELECTION_NONE);
+    members_more_button.set_label("More members");
+    members_more_button.set_no_show_all(true);
+    members_more_button.signal_clicked().connect(
+        sigc::mem_fun(*this, &ChatRoomView::load_members_page)
+    );
+    members_box = Gtk::Box(Gtk::ORIENTATION_VERTICAL, 5);
+    members_box.set_border_width(5);
+    members_box.pack_start(members_scroll, true, true, 0);
+    members_box.pack_start(members_more_button, false, false, 0);
+    members_box.show_all();
+    members_popover.add(members_box);
+    members_popover.signal_show().connect([this]() {
+        if (member_names.empty() && !members_complete) load_members_page();
+    });
 
     // Setup message area
     message_scroll.set_policy(Gtk::POLICY_NEVER, Gtk::POLICY_AUTOMATIC);
     message_scroll.add(message_box);  
     message_scroll.set_size_request(600,500);
+
+    // Shown when only the latest page of history is displayed
+    load_earlier_button.set_label("Load earlier messages");
+    load_earlier_button.set_no_show_all(true);
+    load_earlier_button.signal_clicked().connect(
+        sigc::mem_fun(*this, &ChatRoomView::on_load_earlier_clicked)
+    );
+    load_later_button.set_label("Load newer messages");
+    load_later_button.set_no_show_all(true);
+    load_later_button.signal_clicked().connect(
+        sigc::mem_fun(*this, &ChatRoomView::on_load_later_clicked)
+    );
+    message_scroll.get_vadjustment()->signal_changed().connect(
+        sigc::mem_fun(*this, &ChatRoomView::on_scroll_range_changed)
+    );
     
+    // Find bar, opened with Ctrl+F, Enter or the arrows move between matches
+    find_entry.set_placeholder_text("Find in loaded messages");
+    find_previous_button.set_image_from_icon_name("go-up-symbolic");
+    find_next_button.set_image_from_icon_name("go-down-symbolic");
+    find_box = Gtk::Box(Gtk::ORIENTATION_HORIZONTAL, 5);
+    find_box.pack_start(find_entry, true, true, 0);
+    find_box.pack_start(find_count_label, false, false, 0);
+    find_box.pack_start(find_previous_button, false, false, 0);
+    find_box.pack_start(find_next_button, false, false, 0);
+    find_bar.add(find_box);
+    find_bar.connect_entry(find_entry);
+    find_bar.set_show_close_button(true);
+
+    find_entry.signal_search_changed().connect(
+        sigc::mem_fun(*this, &ChatRoomView::on_find_changed)
+    );
+    find_entry.signal_activate().connect([this]() { on_find_step(1); });
+    find_previous_button.signal_clicked().connect([this]() { on_find_step(-1); });
+    find_next_button.signal_clicked().connect([this]() { on_find_step(1); });
+    find_bar.property_search_mode_enabled().signal_changed().connect([this]() {
+        if (!find_bar.get_search_mode()) clear_find_highlights();
+    });
+    signal_key_press_event().connect(sigc::mem_fun(*this, &ChatRoomView::on_view_key_press), false);
+
+    // Date picker, the room is reloaded from the first message of the picked day
+    jump_button.set_label("Jump to date");
+    jump_button.set_popover(jump_popover);
+    jump_box = Gtk::Box(Gtk::ORIENTATION_VERTICAL, 5);
+    jump_box.set_border_width(5);
+    jump_go_button.set_label("Go");
+    jump_box.pack_start(jump_calendar, false, false, 0);
+    jump_box.pack_start(jump_go_button, false, false, 0);
+    jump_box.show_all();
+    jump_popover.add(jump_box);
+    jump_go_button.signal_clicked().connect(
+        sigc::mem_fun(*this, &ChatRoomView::on_jump_to_date)
+    );
+    jump_calendar.signal_day_selected_double_click().connect(
+        sigc::mem_fun(*this, &ChatRoomView::on_jump_to_date)
+    );
+
     // Setup input area
     message_entry.set_placeholder_text("Type a message...");
     message_entry.set_size_request(-1,40);
     input_box.set_margin_top(10);
     input_box.pack_start(message_entry, true, true, 0);
     input_box.pack_start(send_button, false, false, 0);
+    input_box.pack_start(attach_button, false, false, 0);
+    input_box.pack_start(jump_button, false, false, 0);
     input_box.pack_start(go_back_button, false, false, 0);
 
     // Connect signals
@@ -65,10 +175,23 @@ ChatRoomView::ChatRoomView(DatabaseHandler& db_handler, const std::string& room_
         sigc::mem_fun(*this, &ChatRoomView::on_go_back_clicked)
     );
 
+    attach_button.signal_clicked().connect(
+        sigc::mem_fun(*this, &ChatRoomView::on_attach_clicked)
+    );
+
+    // Typing stops once the entry is emptied, sent or not
+    message_entry.signal_changed().connect([this]() {
+        m_signal_typing.emit(room_id, !message_entry.get_text().empty());
+    });
+
     // Pack widgets
     main_box.pack_start(room_label, false, false, 0);
-    main_box.pack_start(*users_label, false, false, 0);
+    main_box.pack_start(users_box, false, false, 0);
+    main_box.pack_start(presence_label, false, false, 0);
+    main_box.pack_start(find_bar, false, false, 0);
+    main_box.pack_start(load_earlier_button, false, false, 0);
     main_box.pack_start(message_scroll, true, true, 0);
+    main_box.pack_start(load_later_button, false, false, 0);
     main_box.pack_start(input_box, false, false, 0);
     
     add(main_box);
@@ -79,29 +202,681 @@ ChatRoomView::ChatRoomView(DatabaseHandler& db_handler, const std::string& room_
     set_margin_top(20);
     set_margin_bottom(20);
 
-    // Load existing messages
-    load_messages();
+    // Load existing messages. The worker runs in order, so the attachment list it reads
+    // first is in place before the pages it loads next are displayed. The prefetched
+    // page only waits for that list.
+    if (!anchor_message_id.empty()) {
+        load_attachments();
+        load_window();
+    } else if (snapshot) {
+        auto page = std::make_shared<RoomSnapshot>(std::move(*snapshot));
+        history_loading = true;
+        history_token = std::make_shared<CancellationToken>();
+        worker.post([this, page]() { resolve_senders(sender_ids(page->messages)); });
+        load_attachments([this, page, token = history_token]() {
+            // Dropped when a jump to a date replaced it meanwhile
+            if (token == history_token) load_snapshot(*page);
+        });
+    } else {
+        load_attachments();
+        load_messages();
+    }
 
     // Set focus to message entry
     message_entry.grab_focus();
 }
 
+ChatRoomView::~ChatRoomView() {
+    // Abort the history query, the worker then only waits for the cancel to land
+    cancel_history_load();
+    render_idle.disconnect();
+    scroll_anchor_release.disconnect();
+    if (update_tick_id) remove_tick_callback(update_tick_id);
+}
+
+// Renames show up here, an unknown (empty) name keeps the one the view was opened with
+void ChatRoomView::show_room_info(const RoomInfo& info) {
+    if (!info.room_name.empty() && info.room_name != room_name) {
+        room_name = info.room_name;
+        room_label.set_text(room_name);
+    }
+    set_members_text(info.members);
+}
+
+void ChatRoomView::reload_room_info() {
+    auto info = std::make_shared<std::optional<RoomInfo>>();
+    worker.post(
+        [this, info]() {
+            try {
+                *info = db_handler.get_room_info(room_id);
+            } catch (const std::exception& e) {
+                std::cerr << "Error reloading room " << room_id << ": " << e.what() << std::endl;
+            }
+        },
+        [this, info]() {
+            if (*info) queue_room_info(std::move(**info));
+        }
+    );
+}
+
+// "with A, B, C and 9997 others": only the first names are known, the rest is a count
+void ChatRoomView::set_members_text(const MemberSummary& members) {
+    const auto& names = members.first_names;
+    if (members.count == 0 || names.empty()) {
+        users_label->set_text("with no other users");
+        return;
+    }
+
+    std::string users_text = "with ";
+    std::size_t others = members.count > names.size() ? members.count - names.size() : 0;
+    for (size_t i = 0; i < names.size(); ++i) {
+        users_text += names[i];
+        if (i + 2 < names.size() || (i + 2 == names.size() && others > 0)) users_text += ", ";
+        else if (i + 2 == names.size()) users_text += " and ";
+    }
+    if (others > 0) users_text += " and " + std::to_string(others) + (others == 1 ? " other" : " others");
+    users_label->set_text(users_text);
+}
+
+// Forget the browsed pages, the next time the browser opens it starts over
+void ChatRoomView::reset_members() {
+    ++members_generation;
+    member_names.clear();
+    members_after_id.clear();
+    members_loading = false;
+    members_complete = false;
+    for (auto* child : members_list.get_children()) {
+        members_list.remove(*child);
+    }
+    members_more_button.hide();
+    if (members_popover.is_visible()) load_members_page();
+}
+
+// Fetch the page after the last listed member on the worker
+void ChatRoomView::load_members_page() {
+    if (members_loading || members_complete) return;
+    members_loading = true;
+    members_more_button.hide();
+
+    std::string viewer_id = current_user->getUserId();
+    std::string after = members_after_id;
+    auto page = std::make_shared<std::vector<RoomMember>>();
+    auto error = std::make_shared<std::string>();
+    worker.post(
+        [this, viewer_id, after, page, error]() {
+            try {
+                *page = db_handler.get_room_members_page(room_id, viewer_id, after, MEMBERS_PAGE_SIZE);
+            } catch (const std::exception& e) {
+                *error = e.what();
+            }
+        },
+        [this, generation = members_generation, page, error]() {
+            show_members_page(generation, std::move(*page), *error);
+        }
+    );
+}
+
+void ChatRoomView::show_members_page(unsigned generation, std::vector<RoomMember> page, const std::string& error) {
+    if (generation != members_generation) return;
+    members_loading = false;
+    if (!error.empty()) {
+        std::cerr << "Error loading room members: " << error << std::endl;
+        members_more_button.show();
+        return;
+    }
+
+    members_complete = page.size() < static_cast<std::size_t>(MEMBERS_PAGE_SIZE);
+    for (auto& member : page) {
+        auto label = Gtk::manage(new Gtk::Label(member.username));
+        label->set_halign(Gtk::ALIGN_START);
+        label->show();
+        members_list.append(*label);
+        member_names.push_back(std::move(member.username));
+        members_after_id = std::move(member.user_id);
+    }
+    members_more_button.set_visible(!members_complete);
+}
+
+// Typing members first, otherwise how many are around. The names of typing members
+// not seen yet are read on the worker, the label follows once they are in.
+void ChatRoomView::show_presence(const RoomPresence& presence) {
+    shown_presence = presence;
+    const auto& typing = shown_presence.typing_user_ids;
+    if (typing.size() <= 2) {
+        std::vector<std::string> unknown;
+        for (const auto& user_id : typing) {
+            if (!usernames.count(user_id)) unknown.push_back(user_id);
+        }
+        if (!unknown.empty()) {
+            worker.post([this, unknown]() { resolve_senders(unknown); },
+                        [this]() { show_presence(shown_presence); });
+            return;
+        }
+    }
+
+    std::string text;
+    if (typing.size() == 1) {
+        text = username_for(typing[0]) + " is typing...";
+    } else if (typing.size() == 2) {
+        text = username_for(typing[0]) + " and " + username_for(typing[1]) + " are typing...";
+    } else if (typing.size() > 2) {
+        text = std::to_string(typing.size()) + " people are typing...";
+    } else if (!presence.online_user_ids.empty() || !presence.away_user_ids.empty()) {
+        text = std::to_string(presence.online_user_ids.size()) + " online";
+        if (!presence.away_user_ids.empty()) text += ", " + std::to_string(presence.away_user_ids.size()) + " away";
+    }
+    presence_label.set_text(text);
+}
+
+// The attachment list is read on the worker, then loaded_callback runs on the main loop
+void ChatRoomView::load_attachments(std::function<void()> loaded_callback) {
+    auto loaded = std::make_shared<std::optional<AttachmentMap>>();
+    worker.post(
+        [this, loaded]() {
+            try {
+                *loaded = attachment_store.get_room_attachments(room_id);
+            } catch (const std::exception& e) {
+                std::cerr << "Error loading attachments: " << e.what() << std::endl;
+            }
+        },
+        [this, loaded, loaded_callback]() {
+            if (*loaded) attachments = std::move(**loaded);
+            if (loaded_callback) loaded_callback();
+        }
+    );
+}
+
+const AttachmentInfo* ChatRoomView::find_attachment(std::string_view message_id) const {
+    auto found = attachments.find(message_id);
+    return found == attachments.end() ? nullptr : &found->second;
+}
+
+void ChatRoomView::on_attach_clicked() {
+    auto window = dynamic_cast<Gtk::Window*>(get_toplevel());
+    if (!window) return;
+
+    Gtk::FileChooserDialog dialog(*window, "Attach a file", Gtk::FILE_CHOOSER_ACTION_OPEN);
+    dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+    dialog.add_button("_Attach", Gtk::RESPONSE_ACCEPT);
+    if (dialog.run() != Gtk::RESPONSE_ACCEPT) return;
+
+    // Upload off the main loop, the file is read chunk by chunk
+    std::string path = dialog.get_filename();
+    std::string sender_id = current_user->getUserId();
+    auto sent = std::make_shared<std::optional<AttachmentInfo>>();
+    attach_button.set_sensitive(false);
+
+    worker.post(
+        [this, path, sender_id, sent]() {
+            *sent = attachment_store.send_attachment(room_id, sender_id, path);
+        },
+        [this, sent]() {
+            attach_button.set_sensitive(true);
+            if (!*sent) return;
+
+            const AttachmentInfo& attachment = **sent;
+            attachments[attachment.message_id] = attachment;
+            if (has_later_messages) return;
+            sent_message_ids.insert(attachment.message_id);
+            add_message(attachment.file_name, current_user->getUserId(), true, find_attachment(attachment.message_id));
+            find_index.append(attachment.file_name);
+            scroll_to_bottom();
+        }
+    );
+}
+
+void ChatRoomView::on_download_clicked(AttachmentInfo attachment) {
+    auto window = dynamic_cast<Gtk::Window*>(get_toplevel());
+    if (!window) return;
+
+    Gtk::FileChooserDialog dialog(*window, "Save attachment", Gtk::FILE_CHOOSER_ACTION_SAVE);
+    dialog.add_button("_Cancel", Gtk::RESPONSE_CANCEL);
+    dialog.add_button("_Save", Gtk::RESPONSE_ACCEPT);
+    dialog.set_current_name(attachment.file_name);
+    dialog.set_do_overwrite_confirmation(true);
+    if (dialog.run() != Gtk::RESPONSE_ACCEPT) return;
+
+    // The bytes are only fetched now, never while loading the room
+    std::string path = dialog.get_filename();
+    worker.post([this, attachment, path]() {
+        attachment_store.download(attachment, path);
+    });
+}
+
+// Leaving the room abandons its history load, reopening it resumes where it stopped
 void ChatRoomView::on_go_back_clicked(){
+    cancel_history_load();
     m_signal_back_to_chat_list_requested.emit();
 }
 
+// Open the room in one round trip on the worker (members and newest messages), then
+// stream the rest of the history newest first, chunks are rendered as they arrive
 void ChatRoomView::load_messages() {
-    try {
-        auto messages = db_handler.get_room_messages(room_id);
-        last_message_sender_id = "";
-        for (const auto& msg : messages) {
+    TraceSpan span("ChatRoomView::load_messages");
+    history_loading = true;
+    history_stream_done = false;
+    history_token = std::make_shared<CancellationToken>();
+    auto token = history_token;
+    history_flow = std::make_shared<InFlightLimit>(HISTORY_CHUNKS_IN_FLIGHT);
+    auto flow = history_flow;
+    auto started = std::chrono::steady_clock::now();
+    std::string viewer_id = current_user->getUserId();
+    std::string resume_before = oldest_fetched_id;
+    auto resume_before_time = oldest_fetched_time;
+
+    worker.post(
+        [this, token, flow, started, viewer_id, resume_before, resume_before_time]() {
+            std::string before_message_id = resume_before;
+            auto before_time = resume_before_time;
+            if (before_message_id.empty()) {
+                RoomSnapshot opened;
+                try {
+                    opened = db_handler.open_room(room_id, viewer_id, FIRST_CHUNK_SIZE, true, token.get());
+                } catch (const OperationCancelled&) {
+                    return;
+                } catch (const std::exception& e) {
+                    std::cerr << "Error opening room: " << e.what() << std::endl;
+                    opened.members.reset();
+                }
+                Tracer::instance().record_span("ChatRoomView::first_history_chunk", "ui",
+                                               started, std::chrono::steady_clock::now());
+
+                auto first_chunk = std::make_shared<MessageStore>(to_message_store(opened.messages, room_id));
+                resolve_senders(sender_ids(opened.messages));
+                if (!flow->acquire()) return;
+                worker.post_to_main_loop([this, token, flow, first_chunk, name = opened.room_name, members = opened.members]() {
+                    if (token != history_token) {
+                        flow->release();
+                        return;
+                    }
+                    if (members) show_room_info(RoomInfo{name, *members});
+                    else users_label->set_text("with unknown users");
+                    on_history_chunk(first_chunk);
+                });
+                if (!opened.has_earlier_messages) return;
+                before_message_id = opened.messages.front().message_id;
+                before_time = opened.messages.front().timestamp;
+            }
+
+            try {
+                db_handler.stream_room_messages(room_id, CHUNK_SIZE, CHUNK_SIZE,
+                    [this, token, flow](MessageStore&& chunk) {
+                        // Waits here, between two fetches, until the view has rendered a chunk
+                        if (!flow->acquire()) return false;
+                        resolve_senders(sender_ids(chunk));
+                        auto shared_chunk = std::make_shared<MessageStore>(std::move(chunk));
+                        worker.post_to_main_loop([this, token, flow, shared_chunk]() {
+                            if (token == history_token) on_history_chunk(shared_chunk);
+                            else flow->release();
+                        });
+                        return !token->is_cancelled();
+                    },
+                    before_message_id, before_time, token.get());
+            } catch (const OperationCancelled&) {
+                // Resumed from the oldest fetched message when the room is reopened
+            }
+        },
+        [this, token]() {
+            // A load replaced by a jump to another date is dropped
+            if (token == history_token) on_history_loaded(token->is_cancelled());
+        }
+    );
+}
+
+// Chunks are queued and rendered from the idle loop, newest message first
+void ChatRoomView::on_history_chunk(std::shared_ptr<MessageStore> chunk) {
+    if (chunk->empty()) {
+        if (history_flow) history_flow->release();
+        return;
+    }
+    oldest_fetched_id = std::string(chunk->front().message_id);
+    oldest_fetched_time = std::chrono::system_clock::from_time_t(chunk->front().timestamp);
+    if (pending_chunks.empty()) pending_rows = chunk->size();
+    pending_chunks.push_back(std::move(chunk));
+
+    if (!render_idle.connected()) {
+        render_idle = Glib::signal_idle().connect(
+            sigc::mem_fun(*this, &ChatRoomView::on_render_idle), Glib::PRIORITY_DEFAULT_IDLE
+        );
+    }
+}
+
+// Render queued history until the frame budget is used, input and drawing run in between
+bool ChatRoomView::on_render_idle() {
+    TraceSpan span("ChatRoomView::render_history_batch");
+    auto deadline = std::chrono::steady_clock::now() + RENDER_BUDGET;
+    bool is_newest_batch = first_message_sender_id.empty();
+    remember_scroll_position();
+
+    Gtk::Box* batch = nullptr;
+    while (!pending_chunks.empty() && std::chrono::steady_clock::now() < deadline) {
+        if (!batch) batch = start_history_batch();
+        const MessageStore& chunk = *pending_chunks.front();
+        prepend_message(chunk, chunk[--pending_rows], *batch);
+
+        if (pending_rows == 0) {
+            pending_chunks.pop_front();
+            if (!pending_chunks.empty()) pending_rows = pending_chunks.front()->size();
+            if (history_flow) history_flow->release();
+        }
+    }
+
+    // The newest messages open the room scrolled to the bottom
+    if (is_newest_batch) scroll_to_bottom();
+
+    if (!pending_chunks.empty()) return true;
+    finish_history_load();
+    return false;
+}
+
+void ChatRoomView::on_history_loaded(bool interrupted) {
+    history_stream_done = true;
+    history_interrupted = interrupted;
+    finish_history_load();
+}
+
+void ChatRoomView::finish_history_load() {
+    if (!history_stream_done || !pending_chunks.empty()) return;
+    history_loading = false;
+}
+
+// Display the prefetched page, then mark it read and catch up with what was posted
+// since, both on the worker
+void ChatRoomView::load_snapshot(RoomSnapshot& snapshot) {
+    TraceSpan span("ChatRoomView::load_snapshot");
+    history_loading = false;
+    last_message_sender_id = "";
+    for (const auto& msg : snapshot.messages) {
+        bool is_from_current_user = (msg.sender_id == current_user->getUserId());
+        add_message(msg.content, msg.sender_id, is_from_current_user, find_attachment(msg.message_id));
+        find_index.append(msg.content);
+    }
+    if (!snapshot.messages.empty()) {
+        first_message_id = snapshot.messages.front().message_id;
+        first_message_time = snapshot.messages.front().timestamp;
+        last_message_id = snapshot.messages.back().message_id;
+        last_message_time = snapshot.messages.back().timestamp;
+    }
+    load_earlier_button.set_visible(snapshot.has_earlier_messages);
+    scroll_to_bottom();
+
+    // The prefetch read the page without marking it
+    worker.post([this]() {
+        try {
+            db_handler.mark_room_messages_read(room_id);
+        } catch (const std::exception& e) {
+            std::cerr << "Error marking messages as read: " << e.what() << std::endl;
+        }
+    });
+    refresh();
+}
+
+// Page before the oldest displayed message, fetched on the worker with its senders' names
+void ChatRoomView::on_load_earlier_clicked() {
+    TraceSpan span("ChatRoomView::load_earlier");
+    if (first_message_id.empty()) return;
+    load_earlier_button.set_sensitive(false);
+
+    auto token = history_token;
+    auto messages = std::make_shared<std::vector<Message>>();
+    auto loaded = std::make_shared<bool>(false);
+    worker.post(
+        [this, messages, loaded, before = first_message_id, before_time = first_message_time]() {
+            try {
+                *messages = db_handler.get_room_messages_before(room_id, before, before_time, PAGE_SIZE);
+                resolve_senders(sender_ids(*messages));
+                *loaded = true;
+            } catch (const std::exception& e) {
+                std::cerr << "Error loading earlier messages: " << e.what() << std::endl;
+            }
+        },
+        [this, token, messages, loaded, before = first_message_id]() {
+            load_earlier_button.set_sensitive(true);
+            // Dropped when the history was reset or has moved on meanwhile
+            if (!*loaded || token != history_token || before != first_message_id) return;
+            prepend_messages(to_message_store(*messages, room_id));
+            load_earlier_button.set_visible(messages->size() == static_cast<size_t>(PAGE_SIZE));
+        }
+    );
+}
+
+// Members and the page around the anchor message or date, fetched on the worker
+void ChatRoomView::load_window() {
+    TraceSpan span("ChatRoomView::load_window");
+    history_token = std::make_shared<CancellationToken>();
+    auto token = history_token;
+    auto window = std::make_shared<RoomSnapshot>();
+    worker.post(
+        [this, window, message_id = anchor_message_id, time = anchor_time]() {
+            try {
+                *window = time ? db_handler.get_room_messages_at(room_id, *time, PAGE_SIZE)
+                               : db_handler.get_room_messages_around(room_id, message_id, PAGE_SIZE);
+                RoomInfo info = db_handler.get_room_info(room_id);
+                window->room_name = std::move(info.room_name);
+                window->members = std::move(info.members);
+                resolve_senders(sender_ids(window->messages));
+            } catch (const std::exception& e) {
+                std::cerr << "Error loading messages of room " << room_id << ": " << e.what() << std::endl;
+            }
+        },
+        [this, token, window]() {
+            if (token == history_token) show_window(*window);
+        }
+    );
+}
+
+// Display the page with the anchor highlighted and scrolled into view
+void ChatRoomView::show_window(RoomSnapshot& window) {
+    TraceSpan span("ChatRoomView::show_window");
+    if (window.members) show_room_info(RoomInfo{window.room_name, *window.members});
+
+    // Nothing around the anchor (empty room, archived message), follow the room normally
+    if (window.messages.empty()) {
+        anchor_message_id.clear();
+        anchor_time.reset();
+    }
+
+    // A date lands on its first message, or the last one when nothing was posted since
+    if (anchor_time && !window.messages.empty()) {
+        auto first_after = std::find_if(window.messages.begin(), window.messages.end(),
+                                        [this](const Message& msg) { return msg.timestamp >= *anchor_time; });
+        anchor_message_id = (first_after != window.messages.end() ? *first_after : window.messages.back()).message_id;
+    }
+    for (const auto& msg : window.messages) {
+        bool is_from_current_user = (msg.sender_id == current_user->getUserId());
+        auto message_container = add_message(msg.content, msg.sender_id, is_from_current_user,
+                                              find_attachment(msg.message_id));
+        find_index.append(msg.content);
+
+        if (msg.message_id == anchor_message_id) {
+            message_container->override_background_color(Gdk::RGBA("rgba(255, 215, 0, 0.3)"));
+            scroll_target = message_container;
+        }
+    }
+    if (!window.messages.empty()) {
+        first_message_id = window.messages.front().message_id;
+        first_message_time = window.messages.front().timestamp;
+        last_message_id = window.messages.back().message_id;
+        last_message_time = window.messages.back().timestamp;
+    }
+    load_earlier_button.set_visible(window.has_earlier_messages);
+    has_later_messages = window.has_later_messages;
+    load_later_button.set_visible(has_later_messages);
+}
+
+// Page towards the present, fetched on the worker. Once it is reached the room follows
+// new messages again.
+void ChatRoomView::on_load_later_clicked() {
+    TraceSpan span("ChatRoomView::load_later");
+    if (last_message_id.empty()) return;
+    load_later_button.set_sensitive(false);
+
+    auto token = history_token;
+    auto messages = std::make_shared<std::vector<Message>>();
+    auto loaded = std::make_shared<bool>(false);
+    worker.post(
+        [this, messages, loaded, after = last_message_id, after_time = last_message_time]() {
+            try {
+                *messages = db_handler.get_room_messages_after(room_id, after, after_time, PAGE_SIZE + 1);
+                resolve_senders(sender_ids(*messages));
+                *loaded = true;
+            } catch (const std::exception& e) {
+                std::cerr << "Error loading newer messages: " << e.what() << std::endl;
+            }
+        },
+        [this, token, messages, loaded, after = last_message_id]() {
+            load_later_button.set_sensitive(true);
+            // Dropped when the history was reset or has moved on meanwhile
+            if (!*loaded || token != history_token || after != last_message_id) return;
+            show_later_messages(*messages);
+        }
+    );
+}
+
+void ChatRoomView::show_later_messages(std::vector<Message>& messages) {
+    TraceSpan span("ChatRoomView::show_later_messages");
+    has_later_messages = messages.size() > static_cast<size_t>(PAGE_SIZE);
+    if (has_later_messages) messages.pop_back();
+
+    for (const auto& msg : messages) {
+        if (!sent_message_ids.erase(msg.message_id)) {
             bool is_from_current_user = (msg.sender_id == current_user->getUserId());
-            add_message(msg.content, msg.sender_id,is_from_current_user);
+            add_message(msg.content, msg.sender_id, is_from_current_user, find_attachment(msg.message_id));
+            find_index.append(msg.content);
         }
-        scroll_to_bottom();
-    } catch (const std::exception& e) {
-        std::cerr << "Error loading messages: " << e.what() << std::endl;
     }
+    if (!messages.empty()) {
+        last_message_id = messages.back().message_id;
+        last_message_time = messages.back().timestamp;
+    }
+    load_later_button.set_visible(has_later_messages);
+}
+
+void ChatRoomView::on_jump_to_date() {
+    guint year = 0, month = 0, day = 0;
+    jump_calendar.get_date(year, month, day);
+    jump_popover.hide();
+
+    // Local midnight of the picked day, months are counted from 0 like in std::tm
+    std::tm day_start = {};
+    day_start.tm_year = static_cast<int>(year) - 1900;
+    day_start.tm_mon = static_cast<int>(month);
+    day_start.tm_mday = static_cast<int>(day);
+    day_start.tm_isdst = -1;
+
+    reset_history();
+    anchor_time = std::chrono::system_clock::from_time_t(std::mktime(&day_start));
+    load_window();
+}
+
+// Forget the displayed history, a load still running is abandoned and its results dropped
+void ChatRoomView::reset_history() {
+    cancel_history_load();
+    history_token.reset();
+    history_flow.reset();
+    history_loading = false;
+    history_stream_done = false;
+    history_interrupted = false;
+    oldest_fetched_id.clear();
+    render_idle.disconnect();
+    pending_chunks.clear();
+    pending_rows = 0;
+    pending_messages.clear();
+
+    clear_find_highlights();
+    find_matches.clear();
+    find_current.reset();
+    find_index = FindIndex();
+    for (auto* child : message_box.get_children()) {
+        message_box.remove(*child);
+    }
+    message_widgets.clear();
+    sent_message_ids.clear();
+
+    first_message_id.clear();
+    first_message_sender_id.clear();
+    first_message_header = nullptr;
+    last_message_id.clear();
+    last_message_sender_id.clear();
+    anchor_message_id.clear();
+    anchor_time.reset();
+    has_later_messages = false;
+    scroll_target = nullptr;
+    distance_from_bottom.reset();
+    load_earlier_button.hide();
+    load_later_button.hide();
+    load_later_button.set_sensitive(true);
+    load_earlier_button.set_sensitive(true);
+}
+
+// Stops the history stream, also when it is waiting for the view to render a chunk
+void ChatRoomView::cancel_history_load() {
+    if (history_token) history_token->cancel();
+    if (history_flow) history_flow->close();
+}
+
+void ChatRoomView::refresh() {
+    TraceSpan span("ChatRoomView::refresh");
+
+    // Opened in the past, newer messages are paged in with load_later_button
+    if (has_later_messages) return;
+    if (last_message_id.empty() && (!anchor_message_id.empty() || anchor_time)) return;
+
+    // Pick up a history load abandoned when the room was left
+    if (history_interrupted && history_stream_done) {
+        history_interrupted = false;
+        load_messages();
+    }
+
+    // Nothing to catch up from: the newest messages are still on their way, or the room
+    // was empty and opens again like a new view, paged instead of read whole
+    if (last_message_id.empty()) {
+        if (!history_loading) load_messages();
+        return;
+    }
+
+    // Read on the worker with the attachments of what arrived, the room is marked read there
+    auto token = history_token;
+    auto messages = std::make_shared<std::vector<Message>>();
+    auto loaded_attachments = std::make_shared<std::optional<AttachmentMap>>();
+    auto new_sender = std::make_shared<bool>(false);
+    worker.post(
+        [this, messages, loaded_attachments, new_sender, after = last_message_id, after_time = last_message_time]() {
+            try {
+                *messages = db_handler.get_room_messages_after(room_id, after, after_time);
+                *new_sender = resolve_senders(sender_ids(*messages));
+                if (!messages->empty()) *loaded_attachments = attachment_store.get_room_attachments(room_id);
+            } catch (const std::exception& e) {
+                std::cerr << "Error refreshing messages: " << e.what() << std::endl;
+            }
+        },
+        [this, token, messages, loaded_attachments, new_sender, after = last_message_id]() {
+            // Dropped when the history was reset, or an earlier refresh already moved on
+            if (token != history_token || after != last_message_id) return;
+            show_new_messages(*messages, std::move(*loaded_attachments), *new_sender);
+        }
+    );
+}
+
+// Queue what a refresh read for the next frame
+void ChatRoomView::show_new_messages(const std::vector<Message>& messages, std::optional<AttachmentMap> loaded_attachments,
+                                     bool new_sender) {
+    if (loaded_attachments) attachments = std::move(*loaded_attachments);
+    for (const auto& msg : messages) {
+        // Our own messages are already displayed since they were sent
+        if (!sent_message_ids.erase(msg.message_id)) queue_message(msg);
+    }
+    if (!messages.empty()) {
+        if (first_message_id.empty()) {
+            first_message_id = messages.front().message_id;
+            first_message_time = messages.front().timestamp;
+        }
+        last_message_id = messages.back().message_id;
+        last_message_time = messages.back().timestamp;
+    }
+
+    // Someone we have not seen posting may have joined the room
+    if (new_sender && !history_loading) reload_room_info();
 }
 
 void ChatRoomView::on_send_clicked() {
@@ -109,31 +884,282 @@ void ChatRoomView::on_send_clicked() {
     if (message_text.empty()) return;
     
     try {
-        db_handler.send_message(room_id, current_user->getUserId(), message_text);
-        add_message(message_text, current_user->getUserId(), true);
+        std::string message_id = db_handler.send_message(room_id, current_user->getUserId(), message_text);
         message_entry.set_text("");
-        scroll_to_bottom();
+
+        // Opened in the past, the message shows up once the newer pages are loaded
+        if (has_later_messages) return;
+        sent_message_ids.insert(message_id);
+        queue_message(Message(message_id, message_text, current_user->getUserId(),
+                              std::chrono::system_clock::now(), true));
     } catch (const std::exception& e) {
         std::cerr << "Error sending message: " << e.what() << std::endl;
     }
 }
 
+void ChatRoomView::queue_message(const Message& msg) {
+    pending_messages.push_back(msg);
+    schedule_updates();
+}
+
+void ChatRoomView::queue_room_info(RoomInfo info) {
+    pending_info = std::move(info);
+    schedule_updates();
+}
+
+// Live updates wait for the next frame, however many arrive before it
+void ChatRoomView::schedule_updates() {
+    if (update_tick_id == 0) {
+        update_tick_id = add_tick_callback(sigc::mem_fun(*this, &ChatRoomView::on_update_tick));
+    }
+}
+
+bool ChatRoomView::on_update_tick(const Glib::RefPtr<Gdk::FrameClock>&) {
+    update_tick_id = 0;
+    apply_pending_updates();
+    return false;
+}
+
+// The whole batch is laid out once and scrolled once
+void ChatRoomView::apply_pending_updates() {
+    TraceSpan span("ChatRoomView::apply_updates");
+    if (pending_info) {
+        show_room_info(*pending_info);
+        reset_members();
+        pending_info.reset();
+    }
+    if (pending_messages.empty()) return;
+
+    for (const auto& msg : pending_messages) {
+        bool is_from_current_user = (msg.sender_id == current_user->getUserId());
+        add_message(msg.content, msg.sender_id, is_from_current_user, find_attachment(msg.message_id));
+        find_index.append(msg.content);
+    }
+    pending_messages.clear();
+    scroll_to_bottom();
+    m_signal_room_activity.emit(room_id, room_name);
+}
+
+bool ChatRoomView::on_view_key_press(GdkEventKey* event) {
+    if ((event->state & GDK_CONTROL_MASK) && (event->keyval == GDK_KEY_f || event->keyval == GDK_KEY_F)) {
+        find_bar.set_search_mode(true);
+        find_entry.grab_focus();
+        return true;
+    }
+    return false;
+}
+
+// A new text starts from the most recent match, the one closest to the bottom
+void ChatRoomView::on_find_changed() {
+    TraceSpan span("ChatRoomView::find");
+    find_matches = find_index.find(std::string(find_entry.get_text()));
+    find_current.reset();
+    if (!find_matches.empty()) {
+        find_current = static_cast<std::int64_t>(find_matches.back()) - find_index.prepended_count();
+    }
+    show_find_match();
+}
+
+// Step to the next (1) or previous (-1) match, wrapping around. Repeating the search
+// only scans the messages loaded since, so new ones are found too.
+void ChatRoomView::on_find_step(int direction) {
+    find_matches = find_index.find(std::string(find_entry.get_text()));
+    if (find_matches.empty()) {
+        find_current.reset();
+        show_find_match();
+        return;
+    }
+
+    std::size_t position = find_matches.size() - 1;
+    if (find_current) {
+        auto current = static_cast<std::size_t>(*find_current + find_index.prepended_count());
+        auto found = std::lower_bound(find_matches.begin(), find_matches.end(), current);
+        if (direction > 0) {
+            if (found != find_matches.end() && *found == current) ++found;
+            position = found == find_matches.end() ? 0 : found - find_matches.begin();
+        } else {
+            position = found == find_matches.begin() ? find_matches.size() - 1 : (found - find_matches.begin()) - 1;
+        }
+    }
+    find_current = static_cast<std::int64_t>(find_matches[position]) - find_index.prepended_count();
+    show_find_match();
+}
+
+// Matched messages are tinted, the current one more strongly, and scrolled into view
+void ChatRoomView::show_find_match() {
+    clear_find_highlights();
+    if (!find_current) {
+        find_count_label.set_text(find_entry.get_text().empty() ? "" : "No matches");
+        return;
+    }
+
+    // Past FIND_HIGHLIGHT_LIMIT matches (a single letter) restyling them all would stall the frame
+    auto current = static_cast<std::size_t>(*find_current + find_index.prepended_count());
+    bool tint_all = find_matches.size() <= FIND_HIGHLIGHT_LIMIT;
+    std::size_t position = 0;
+    for (std::size_t i = 0; i < find_matches.size(); ++i) {
+        std::size_t index = find_matches[i];
+        if (index == current) position = i;
+        if (index >= message_widgets.size() || (!tint_all && index != current)) continue;
+        Gtk::Widget* widget = message_widgets[index];
+        widget->override_background_color(Gdk::RGBA(index == current ? "rgba(255, 165, 0, 0.45)"
+                                                                      : "rgba(255, 215, 0, 0.2)"));
+        find_highlighted.push_back(widget);
+    }
+    find_count_label.set_text(std::to_string(position + 1) + " of " + std::to_string(find_matches.size()));
+    if (current < message_widgets.size()) scroll_to_widget(*message_widgets[current]);
+}
+
+void ChatRoomView::clear_find_highlights() {
+    for (auto* widget : find_highlighted) widget->unset_background_color();
+    find_highlighted.clear();
+}
+
+// Only a lookup, the names were read on the worker before the messages were handed over
+const std::string& ChatRoomView::username_for(std::string_view sender_id) const {
+    static const std::string unknown = "Unknown User";
+    auto known = usernames.find(sender_id);
+    return known != usernames.end() ? known->second : unknown;
+}
+
+// Runs on the worker: reads the usernames of the senders it has not looked up yet in one
+// query, and posts them to the main loop ahead of the messages posted after this call.
+// Returns whether there were any.
+bool ChatRoomView::resolve_senders(const std::vector<std::string>& sender_ids) {
+    std::vector<std::string> missing;
+    for (const auto& sender_id : sender_ids) {
+        if (resolved_sender_ids.insert(sender_id).second) missing.push_back(sender_id);
+    }
+    if (missing.empty()) return false;
+
+    std::map<std::string, std::string> names;
+    try {
+        names = db_handler.get_usernames_by_id(missing);
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading usernames: " << e.what() << std::endl;
+    }
+    for (const auto& sender_id : missing) names.emplace(sender_id, "Unknown User");
+    worker.post_to_main_loop([this, names = std::move(names)]() {
+        usernames.insert(names.begin(), names.end());
+    });
+    return true;
+}
+
 // add message to the Scrolled Window
-void ChatRoomView::add_message(const std::string& content, const std::string& sender_id, bool is_from_current_user) {
-    auto message_container = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_VERTICAL));
+Gtk::Box* ChatRoomView::add_message(const std::string& content, const std::string& sender_id, bool is_from_current_user,
+                                    const AttachmentInfo* attachment) {
+    TraceSpan span("ChatRoomView::add_message");
+    bool is_first = first_message_sender_id.empty();
 
     // Add username label if sender has changed
-    if (sender_id != last_message_sender_id) {
+    Gtk::Label* header = nullptr;
+    auto message_container = create_message_widget(content, sender_id, is_from_current_user,
+                                                   sender_id != last_message_sender_id, &header, attachment);
+    message_box.pack_start(*message_container, false, false, 0);
+    message_container->show_all();
+    message_widgets.push_back(message_container);
+
+    if (is_first) {
+        first_message_sender_id = sender_id;
+        first_message_header = header;
+    }
+    last_message_sender_id = sender_id;
+    return message_container;
+}
+
+// Insert a chunk of earlier messages (oldest first) above the displayed ones
+void ChatRoomView::prepend_messages(const MessageStore& chunk) {
+    TraceSpan span("ChatRoomView::prepend_messages");
+    remember_scroll_position();
+    Gtk::Box* batch = start_history_batch();
+    for (size_t i = chunk.size(); i-- > 0;) {
+        prepend_message(chunk, chunk[i], *batch);
+    }
+}
+
+// Box above the displayed messages receiving the next rows of history. Inserting each row
+// at the front of message_box walks all of its children, rows of a batch are packed from
+// its end instead (newest first lands at the bottom) and only the batch goes to the front.
+Gtk::Box* ChatRoomView::start_history_batch() {
+    auto batch = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_VERTICAL, 10));
+    message_box.pack_start(*batch, false, false, 0);
+    message_box.reorder_child(*batch, 0);
+    batch->show();
+    return batch;
+}
+
+// Insert one message above the displayed ones, newest first. The ids are only viewed in
+// the chunk, which is dropped once rendered.
+void ChatRoomView::prepend_message(const MessageStore& chunk, const MessageRow& row, Gtk::Box& batch) {
+    std::string_view sender_id = chunk.sender_id(row);
+    bool is_from_current_user = (sender_id == current_user->getUserId());
+    bool was_empty = first_message_sender_id.empty();
+
+    // Sent while the first page was on its way, already shown at the bottom
+    if (!sent_message_ids.empty() && sent_message_ids.erase(std::string(row.message_id))) return;
+
+    Gtk::Label* header = nullptr;
+    auto message_container = create_message_widget(std::string(row.content), sender_id, is_from_current_user,
+                                                   true, &header, find_attachment(row.message_id));
+    batch.pack_end(*message_container, false, false, 0);
+    message_container->show_all();
+    message_widgets.push_front(message_container);
+
+    // The former first message now continues this sender's group
+    if (first_message_header && first_message_sender_id == sender_id) {
+        first_message_header->hide();
+    }
+
+    find_index.prepend(row.content);
+
+    // Assigned in place, the strings keep their capacity from one row to the next
+    first_message_id = row.message_id;
+    first_message_time = std::chrono::system_clock::from_time_t(row.timestamp);
+    first_message_sender_id = sender_id;
+    first_message_header = header;
+    if (was_empty) {
+        last_message_sender_id = sender_id;
+        last_message_id = row.message_id;
+        last_message_time = first_message_time;
+    }
+}
+
+// Prepending grows the content above what is on screen, keep the same distance to the bottom
+void ChatRoomView::remember_scroll_position() {
+    auto adjustment = message_scroll.get_vadjustment();
+    distance_from_bottom = adjustment->get_upper() - adjustment->get_value();
+}
+
+// Applied once the new content is laid out, then released
+void ChatRoomView::on_scroll_range_changed() {
+    if (!distance_from_bottom && !scroll_target) return;
+    auto adjustment = message_scroll.get_vadjustment();
+    if (distance_from_bottom) {
+        adjustment->set_value(std::max(0.0, adjustment->get_upper() - *distance_from_bottom));
+    }
+
+    // The target position is only known once its row is allocated, after the range change
+    if (!scroll_anchor_release.connected()) {
+        scroll_anchor_release = Glib::signal_idle().connect([this]() {
+            if (scroll_target) {
+                scroll_to_widget(*scroll_target);
+                scroll_target = nullptr;
+            }
+            distance_from_bottom.reset();
+            return false;
+        });
+    }
+}
 
+// Build the bubble of one message, with the sender name on top when show_sender is set
+Gtk::Box* ChatRoomView::create_message_widget(const std::string& content, std::string_view sender_id,
+                                              bool is_from_current_user, bool show_sender, Gtk::Label** header,
+                                              const AttachmentInfo* attachment) {
+    auto message_container = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_VERTICAL));
+
+    if (show_sender) {
         auto username_label = Gtk::manage(new Gtk::Label());
-        std::string username;
-        try {
-            username = db_handler.get_username_by_id(sender_id);
-        } catch (const std::exception& e) {
-            username = "Unknown User";
-        }
-        
-        username_label->set_text(username);
+        username_label->set_text(username_for(sender_id));
         username_label->set_halign(is_from_current_user ? Gtk::ALIGN_END : Gtk::ALIGN_START);
         username_label->get_style_context()->add_class("title-4");
         username_label->set_margin_start(10);
@@ -142,11 +1168,22 @@ void ChatRoomView::add_message(const std::string& content, const std::string& se
             
         username_label->override_color(Gdk::RGBA("white"));
         message_container->pack_start(*username_label, false, false, 0);
+        *header = username_label;
     }
 
     auto message_box_horizontal = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_HORIZONTAL));
 
-    auto message_label = Gtk::manage(new Gtk::Label(content));
+    // Attachments show their name and size, with a button to fetch the content
+    std::string text = content;
+    if (attachment) {
+        double size_kb = static_cast<double>(attachment->size_bytes) / 1024.0;
+        std::ostringstream size_text;
+        size_text << std::fixed << std::setprecision(1)
+                  << (size_kb < 1024.0 ? size_kb : size_kb / 1024.0) << (size_kb < 1024.0 ? " KB" : " MB");
+        text = "File: " + attachment->file_name + " (" + size_text.str() + ")";
+    }
+
+    auto message_label = Gtk::manage(new Gtk::Label(text));
     message_label->set_line_wrap(true);
     message_label->set_line_wrap_mode(Pango::WRAP_WORD_CHAR);
     message_label->set_max_width_chars(50);
@@ -156,7 +1193,18 @@ void ChatRoomView::add_message(const std::string& content, const std::string& se
     message_label->override_font(font_desc);
 
     auto message_frame = Gtk::manage(new Gtk::Frame());
-    message_frame->add(*message_label);
+    if (attachment) {
+        auto attachment_box = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_VERTICAL, 5));
+        auto download_button = Gtk::manage(new Gtk::Button("Download"));
+        download_button->signal_clicked().connect(
+            sigc::bind(sigc::mem_fun(*this, &ChatRoomView::on_download_clicked), *attachment)
+        );
+        attachment_box->pack_start(*message_label, false, false, 0);
+        attachment_box->pack_start(*download_button, false, false, 0);
+        message_frame->add(*attachment_box);
+    } else {
+        message_frame->add(*message_label);
+    }
     message_frame->set_margin_start(10);
     message_frame->set_margin_end(10);
     message_frame->set_margin_top(5);
@@ -181,13 +1229,22 @@ void ChatRoomView::add_message(const std::string& content, const std::string& se
     }
     
     message_container->pack_start(*message_box_horizontal,false,false,0);
-    message_box.pack_start(*message_container, false, false, 0);
-    message_container->show_all();
+    return message_container;
+}
 
-    last_message_sender_id = sender_id;
+// Bring a message into view, a third of the way down
+void ChatRoomView::scroll_to_widget(Gtk::Widget& widget) {
+    auto adjustment = message_scroll.get_vadjustment();
+    int x = 0, y = 0;
+    if (widget.translate_coordinates(message_box, 0, 0, x, y)) {
+        adjustment->set_value(std::max(0.0, y - adjustment->get_page_size() / 3));
+    }
 }
 
 void ChatRoomView::scroll_to_bottom() {
     auto adjustment = message_scroll.get_vadjustment();
     adjustment->set_value(adjustment->get_upper());
+
+    // Stay at the bottom once the new messages are laid out
+    distance_from_bottom = adjustment->get_page_size();
 }
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include "connection_pool.h"
+
+#include <iostream>
+#include <iterator>
+
+ConnectionPool::ConnectionPool(std::string conn_str, std::size_t max_idle)
+    : conn_str(std::move(conn_str)), max_idle(max_idle) {
+}
+
+// Most recently used first, its server side caches are the warmest
+ConnectionPool::Idle ConnectionPool::take(std::chrono::milliseconds statement_timeout) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (idle.empty()) return Idle{};
+
+    auto taken = idle.end() - 1;
+    for (auto it = idle.rbegin(); it != idle.rend(); ++it) {
+        if (it->statement_timeout == statement_timeout) {
+            taken = std::next(it).base();
+            break;
+        }
+    }
+    Idle result = std::move(*taken);
+    idle.erase(taken);
+    return result;
+}
+
+void ConnectionPool::give_back(Idle returned) {
+    returned.idle_since = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (idle.size() < max_idle) idle.push_back(std::move(returned));
+}
+
+// PooledConnection
+PooledConnection::PooledConnection(ConnectionPool* pool, ConnectionPool::Idle idle)
+    : pool(pool), idle(std::move(idle)) {
+}
+
+// A connection lost or discarded during the operation is not given back
+PooledConnection::~PooledConnection() {
+    if (!pool || !idle.connection || discarded) return;
+    try {
+        if (idle.connection->is_open()) pool->give_back(std::move(idle));
+    } catch (const std::exception& e) {
+        std::cerr << "Could not give back a connection: " << e.what() << std::endl;
+    }
+}
@@ -1,19 +1,250 @@
 #include "database_handler.h"
+#include "queries.h"
 
 // Constructor
-DatabaseHandler::DatabaseHandler(const std::string& connStr)
-    : connStr(connStr) {
+DatabaseHandler::DatabaseHandler(const std::string& connStr, const std::vector<std::string>& replicaConnStrs,
+                                 const std::vector<std::string>& shardConnStrs)
+    : connStr(connStr), room_cache(query_metrics.cache("room")), shards(shardConnStrs) {
+    for (const auto& replicaConnStr : replicaConnStrs) {
+        replicas.push_back(std::make_unique<Replica>());
+        replicas.back()->connStr = replicaConnStr;
+    }
+
+    // One pool per database, the map does not change afterwards
+    pools.emplace(connStr, std::make_unique<ConnectionPool>(connStr, POOL_MAX_IDLE));
+    for (const auto& replicaConnStr : replicaConnStrs) {
+        pools.emplace(replicaConnStr, std::make_unique<ConnectionPool>(replicaConnStr, POOL_MAX_IDLE));
+    }
+    for (const auto& shardConnStr : shardConnStrs) {
+        pools.emplace(shardConnStr, std::make_unique<ConnectionPool>(shardConnStr, POOL_MAX_IDLE));
+    }
+
+    // Loads behind a view are abandoned rather than left to run for minutes,
+    // the streamed history is limited per FETCH
+    set_statement_timeout("open_room", std::chrono::seconds(5));
+    set_statement_timeout("get_room_info", std::chrono::seconds(5));
+    set_statement_timeout("get_room_members_page", std::chrono::seconds(5));
+    set_statement_timeout("get_room_messages_after", std::chrono::seconds(5));
+    set_statement_timeout("get_room_messages_before", std::chrono::seconds(5));
+    set_statement_timeout("get_room_messages_around", std::chrono::seconds(5));
+    set_statement_timeout("get_room_messages_at", std::chrono::seconds(5));
+    set_statement_timeout("search_messages", std::chrono::seconds(10));
+    set_statement_timeout("presence_heartbeat", std::chrono::seconds(2));
+    set_statement_timeout("stream_room_messages", std::chrono::seconds(30));
 }
 
 // Connect to the database
-pqxx::connection DatabaseHandler::createConnection(){
+pqxx::connection DatabaseHandler::connect(const std::string& conn_str){
     try {
-        return pqxx::connection(connStr);
+        QueryMetrics::AcquireScope acquire(query_metrics);
+        return pqxx::connection(conn_str);
     } catch (const std::exception& e) {
         throw std::runtime_error("Database connection error: " + std::string(e.what()));
     }
 }
 
+// A connection from the pool of the database, with the statement timeout of the operation:
+// a new connection gets it through the startup packet, a pooled one that had another
+// timeout through a SET (to 0 for none, RESET would go back to the startup value). One
+// idle for a while is checked with a round trip, the server may have closed it.
+PooledConnection DatabaseHandler::acquire(const std::string& conn_str, const std::string& operation){
+    auto found = pools.find(conn_str);
+    ConnectionPool* pool = found != pools.end() ? found->second.get() : nullptr;
+    std::chrono::milliseconds timeout = statementTimeout(operation);
+
+    QueryMetrics::AcquireScope acquire(query_metrics);
+    ConnectionPool::Idle idle;
+    if (pool) idle = pool->take(timeout);
+    if (idle.connection) {
+        try {
+            if (idle.statement_timeout != timeout) {
+                pqxx::nontransaction txn(*idle.connection);
+                txn.exec("SET statement_timeout = " + std::to_string(timeout.count()));
+                idle.statement_timeout = timeout;
+            } else if (std::chrono::steady_clock::now() - idle.idle_since > POOL_IDLE_CHECK) {
+                pqxx::nontransaction txn(*idle.connection);
+                txn.exec("SELECT 1");
+            }
+            return PooledConnection(pool, std::move(idle));
+        } catch (const std::exception&) {
+            // Lost while idle, a new connection replaces it
+        }
+    }
+
+    try {
+        idle.connection = std::make_unique<pqxx::connection>(withStatementTimeout(conn_str, operation));
+        idle.statement_timeout = timeout;
+        return PooledConnection(pool, std::move(idle));
+    } catch (const std::exception& e) {
+        throw std::runtime_error("Database connection error: " + std::string(e.what()));
+    }
+}
+
+PooledConnection DatabaseHandler::createConnection(){
+    return acquire(connStr, "");
+}
+
+PooledConnection DatabaseHandler::createConnection(const std::string& operation){
+    return acquire(connStr, operation);
+}
+
+// Reads go to the next replica in turn, unless it has not replayed our last write yet.
+// Its replay is polled on the connection the read then uses.
+PooledConnection DatabaseHandler::createReadConnection(const std::string& operation){
+    if (replicas.empty()) return createConnection(operation);
+
+    Replica& replica = *replicas[next_replica.fetch_add(1) % replicas.size()];
+    PooledConnection dbConnection = acquire(replica.connStr, operation);
+    std::uint64_t write_lsn = last_write_lsn.load();
+    if (replica.replayed_lsn.load() < write_lsn && !waitForReplay(replica, dbConnection, write_lsn)) {
+        return createConnection(operation);
+    }
+    return dbConnection;
+}
+
+// The database holding a room: its shard, or the only database when not sharded
+PooledConnection DatabaseHandler::createRoomConnection(const std::string& room_id, const std::string& operation){
+    if (shards.empty()) return createConnection(operation);
+    return acquire(shards.connection_string_for(room_id), operation);
+}
+
+// Replicas only serve the unsharded database, a shard is read from directly
+PooledConnection DatabaseHandler::createRoomReadConnection(const std::string& room_id, const std::string& operation){
+    if (shards.empty()) return createReadConnection(operation);
+    return acquire(shards.connection_string_for(room_id), operation);
+}
+
+pqxx::connection DatabaseHandler::createRoomDatabaseConnection(std::size_t index){
+    if (shards.empty()) return connect(connStr);
+    return connect(shards.connection_string(index));
+}
+
+// Run a query on every shard in parallel (or once on the only database), one result per shard
+std::vector<pqxx::result> DatabaseHandler::queryAllShards(const std::string& operation,
+                                                         const std::function<pqxx::result(pqxx::work&)>& query) {
+    if (shards.empty()) {
+        PooledConnection dbConnection = createReadConnection(operation);
+        pqxx::work txn(dbConnection);
+        pqxx::result result = query(txn);
+        txn.commit();
+        return {result};
+    }
+
+    std::vector<std::future<pqxx::result>> pending;
+    for (std::size_t shard = 0; shard < shards.size(); ++shard) {
+        pending.push_back(std::async(std::launch::async, [this, shard, &operation, &query]() {
+            PooledConnection dbConnection = acquire(shards.connection_string(shard), operation);
+            pqxx::work txn(dbConnection);
+            pqxx::result result = query(txn);
+            txn.commit();
+            return result;
+        }));
+    }
+
+    // A failed shard fails the call, the other futures are still waited for on the way out
+    std::vector<pqxx::result> results;
+    for (auto& shard_result : pending) results.push_back(shard_result.get());
+    return results;
+}
+
+// Fill the pools while the window is being built. The first connection of the process pays
+// for the libpq and TLS setup and the name lookups, the login lookup then finds the users
+// index pages cached by the server. All the connections are opened in parallel and held
+// until the last one is up, so each pool ends up with POOL_WARM_CONNECTIONS idle ones.
+bool DatabaseHandler::warm_up() {
+    QueryMetrics::Scope op(query_metrics.operation("warm_up"));
+    std::vector<std::future<PooledConnection>> pending;
+    for (const auto& pool : pools) {
+        std::size_t count = pool.first == connStr ? POOL_WARM_CONNECTIONS - 1 : POOL_WARM_CONNECTIONS;
+        for (std::size_t i = 0; i < count; ++i) {
+            pending.push_back(std::async(std::launch::async, [this, &pool]() { return acquire(pool.first, ""); }));
+        }
+    }
+
+    bool warmed_up = true;
+    std::vector<PooledConnection> warmed;
+    try {
+        warmed.push_back(createConnection("verify_user_credentials"));
+        pqxx::nontransaction txn(warmed.back());
+        txn.exec_params(queries::VERIFY_USER_CREDENTIALS, "", "");
+    } catch (const std::exception& e) {
+        warmed_up = false;
+        std::cerr << "Database warm-up failed: " << e.what() << std::endl;
+    }
+    for (auto& connected : pending) {
+        try {
+            warmed.push_back(connected.get());
+        } catch (const std::exception& e) {
+            warmed_up = false;
+            std::cerr << "Database warm-up failed: " << e.what() << std::endl;
+        }
+    }
+    if (!warmed_up) op.fail();
+    return warmed_up;
+}
+
+// Zero when the operation has none
+std::chrono::milliseconds DatabaseHandler::statementTimeout(const std::string& operation) const {
+    auto timeout = statement_timeouts.find(operation);
+    return timeout == statement_timeouts.end() ? std::chrono::milliseconds(0) : timeout->second;
+}
+
+// The timeout is set through the startup packet, so it costs no extra round trip
+std::string DatabaseHandler::withStatementTimeout(const std::string& conn_str, const std::string& operation) const {
+    std::chrono::milliseconds timeout = statementTimeout(operation);
+    if (timeout.count() == 0) return conn_str;
+    return conn_str + " options='-c statement_timeout=" + std::to_string(timeout.count()) + "'";
+}
+
+// Remember where the WAL was after a committed write, later reads must see it
+void DatabaseHandler::recordWrite(pqxx::connection& connection) {
+    if (replicas.empty() || !shards.empty()) return;
+    try {
+        pqxx::nontransaction txn(connection);
+        std::uint64_t lsn = parseLsn(txn.exec("SELECT pg_current_wal_lsn()::text")[0][0].as<std::string>());
+        std::uint64_t previous = last_write_lsn.load();
+        while (previous < lsn && !last_write_lsn.compare_exchange_weak(previous, lsn)) {}
+    } catch (const std::exception& e) {
+        std::cerr << "Could not read the write position: " << e.what() << std::endl;
+    }
+}
+
+// Poll the replica until it has replayed the given position, false if it stays behind
+bool DatabaseHandler::waitForReplay(Replica& replica, pqxx::connection& connection, std::uint64_t lsn) {
+    auto deadline = std::chrono::steady_clock::now() + READ_YOUR_WRITES_WAIT;
+    try {
+        pqxx::nontransaction txn(connection);
+        while (true) {
+            pqxx::result result = txn.exec("SELECT pg_last_wal_replay_lsn()::text");
+            if (!result[0][0].is_null()) {
+                std::uint64_t replayed = parseLsn(result[0][0].as<std::string>());
+                std::uint64_t previous = replica.replayed_lsn.load();
+                while (previous < replayed && !replica.replayed_lsn.compare_exchange_weak(previous, replayed)) {}
+                if (replayed >= lsn) return true;
+            }
+            if (std::chrono::steady_clock::now() >= deadline) return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Replica unavailable, reading from the primary: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// "16/B374D848" -> 0x16B374D848
+std::uint64_t DatabaseHandler::parseLsn(const std::string& lsn) {
+    auto separator = lsn.find('/');
+    if (separator == std::string::npos) return 0;
+    return (std::stoull(lsn.substr(0, separator), nullptr, 16) << 32) |
+           std::stoull(lsn.substr(separator + 1), nullptr, 16);
+}
+
+// Zero disables the timeout of the operation
+void DatabaseHandler::set_statement_timeout(const std::string& operation, std::chrono::milliseconds timeout) {
+    if (timeout.count() > 0) statement_timeouts[operation] = timeout;
+    else statement_timeouts.erase(operation);
+}
+
 // User session methods
 void DatabaseHandler::setCurrentUser(std::optional<User> user) { current_user = user; }
 const User& DatabaseHandler::getCurrentUser() const { 
@@ -42,18 +273,15 @@ std::string DatabaseHandler::hashPassword(const std::string& password) {
 
 // Verify user credentials
 std::optional<User> DatabaseHandler::verifyUserCredentials(const std::string& username, const std::string& hashedPassword) {
+    QueryMetrics::Scope op(query_metrics.operation("verify_user_credentials"));
     try {
         
-        pqxx::connection dbConnection = createConnection();
+        PooledConnection dbConnection = createConnection();
         pqxx::work txn(dbConnection);
 
         // SQL query to fetch user details
-        std::string query = 
-            "SELECT user_id, username, password_hash "
-            "FROM users WHERE username = " + txn.quote(username) +
-            " AND password_hash = " + txn.quote(hashedPassword);
-
-        auto result = txn.exec(query);
+        auto result = txn.exec_params(queries::VERIFY_USER_CREDENTIALS, username, hashedPassword);
+        op.rows(result.size());
 
         if (!result.empty()) {
             // Extract data from the query result
@@ -70,85 +298,129 @@ std::optional<User> DatabaseHandler::verifyUserCredentials(const std::string& us
 
     } catch (const std::exception& e) {
         // Log the error
+        op.fail();
         std::cerr << "Error verifying credentials: " << e.what() << std::endl;
         return std::nullopt;
     };
 }
 
 // Retrieve user conversations
+// The public lookups below share identical in-flight queries (a double-click, concurrent refreshes)
 std::vector<std::pair<std::string, std::string>> DatabaseHandler::get_user_conversations(const std::string& current_user_id) {
+    try {
+        return load_user_conversations(current_user_id);
+    } catch (const std::exception& e) {
+        std::cerr << "Database error in get_user_conversations: " << e.what() << std::endl;
+        return {};
+    }
+}
+
+std::vector<std::pair<std::string, std::string>> DatabaseHandler::load_user_conversations(const std::string& current_user_id) {
+    return conversations_flight.run(current_user_id, query_metrics.operation("get_user_conversations"),
+                                    [&]() { return fetch_user_conversations(current_user_id); });
+}
+
+std::vector<std::pair<std::string, std::string>> DatabaseHandler::fetch_user_conversations(const std::string& current_user_id) {
     std::vector<std::pair<std::string, std::string>> conversations;
+    QueryMetrics::Scope op(query_metrics.operation("get_user_conversations"));
     try {
-        // Query to get all chat rooms the user is a member of
-        std::string query = R"(
-            SELECT cr.room_id, cr.room_name
-            FROM chat_rooms cr
-            INNER JOIN chat_room_members crm ON cr.room_id = crm.room_id
-            WHERE crm.user_id = $1
-            ORDER BY cr.created_at DESC;
-        )";
-        
-        // Create a prepared statement
-        pqxx::connection dbConnection = createConnection();
-        pqxx::work txn(dbConnection);
-        pqxx::result result = txn.exec_params(query, current_user_id);
-        
-        // Process the results
-        for (const auto& row : result) {
-            std::string room_id = row[0].as<std::string>();
-            std::string room_name = row[1].as<std::string>();
-            conversations.emplace_back(room_id, room_name);
+        // Each shard holds part of the rooms, the shards are queried in parallel
+        std::vector<pqxx::result> results = queryAllShards("get_user_conversations", [&](pqxx::work& txn) {
+            return txn.exec_params(queries::USER_CONVERSATIONS, current_user_id);
+        });
+
+        // Merge the per shard lists, newest room first
+        std::vector<std::tuple<double, std::string, std::string>> rooms;
+        for (const auto& result : results) {
+            op.rows(result.size());
+            for (const auto& row : result) {
+                rooms.emplace_back(row[2].as<double>(), row[0].as<std::string>(), row[1].as<std::string>());
+            }
+        }
+        if (results.size() > 1) {
+            std::stable_sort(rooms.begin(), rooms.end(), [](const auto& a, const auto& b) {
+                return std::get<0>(a) > std::get<0>(b);
+            });
+        }
+        for (auto& [created, room_id, room_name] : rooms) {
+            conversations.emplace_back(std::move(room_id), std::move(room_name));
         }
-        
-        txn.commit();
     } catch (const std::exception& e) {
-        std::cerr << "Database error in get_user_conversations: " << e.what() << std::endl;
+        op.fail();
+        throw std::runtime_error("Failed to get user conversations: " + std::string(e.what()));
     }
     
     return conversations;
 }
 
+// Rooms of the user ordered by their latest message, used to pick what to prefetch
+std::vector<std::string> DatabaseHandler::get_most_active_rooms(const std::string& user_id, int limit) {
+    std::vector<std::string> room_ids;
+    QueryMetrics::Scope op(query_metrics.operation("get_most_active_rooms"));
+    try {
+        std::vector<pqxx::result> results = queryAllShards("get_most_active_rooms", [&](pqxx::work& txn) {
+            return txn.exec_params(queries::MOST_ACTIVE_ROOMS, user_id, limit);
+        });
+
+        // Every shard returns its own top rooms, the overall top ones are among them
+        std::vector<std::pair<double, std::string>> rooms;
+        for (const auto& result : results) {
+            op.rows(result.size());
+            for (const auto& row : result) {
+                rooms.emplace_back(row[1].is_null() ? -1.0 : row[1].as<double>(), row[0].as<std::string>());
+            }
+        }
+        if (results.size() > 1) {
+            std::stable_sort(rooms.begin(), rooms.end(), [](const auto& a, const auto& b) {
+                return a.first > b.first;
+            });
+        }
+        for (auto& room : rooms) {
+            if (room_ids.size() == static_cast<std::size_t>(limit)) break;
+            room_ids.push_back(std::move(room.second));
+        }
+
+    } catch (const std::exception& e) {
+        op.fail();
+        throw std::runtime_error("Failed to get most active rooms: " + std::string(e.what()));
+    }
+
+    return room_ids;
+}
+
 // Get or create a chat room
+// Best effort, a room left behind is only unlisted
+void DatabaseHandler::deleteShardRoom(const std::string& room_id) {
+    try {
+        PooledConnection shardConnection = createRoomConnection(room_id, "get_or_create_chat_room");
+        pqxx::work txn(shardConnection);
+        txn.exec_params(queries::DELETE_UNLISTED_ROOM, room_id);
+        txn.commit();
+    } catch (const std::exception& e) {
+        std::cerr << "Could not delete the unlisted room " << room_id << ": " << e.what() << std::endl;
+    }
+}
+
 std::string DatabaseHandler::get_or_create_chat_room(const std::vector<std::string>& user_ids, const std::string& room_name) {
+    QueryMetrics::Scope op(query_metrics.operation("get_or_create_chat_room"));
     try {
-        pqxx::connection dbConnection = createConnection();
-        pqxx::work txn(dbConnection);
-        
-        // Sort user IDs for consistent querying
+        // Sort user IDs for consistent querying, each member counted once
         std::vector<std::string> sorted_user_ids = user_ids;
         std::sort(sorted_user_ids.begin(), sorted_user_ids.end());
-        
-        std::string find_query =
-            "WITH RoomCounts AS ("
-            " SELECT cr.room_id, COUNT(*) as member_count"
-            " FROM chat_rooms cr"
-            " JOIN chat_room_members crm ON cr.room_id = crm.room_id"
-            " GROUP BY cr.room_id"
-            " HAVING COUNT(*) = $1"
-            ")"
-            "SELECT cr.room_id "
-            "FROM chat_rooms cr "
-            "JOIN chat_room_members crm ON cr.room_id = crm.room_id "
-            "WHERE cr.room_id IN (SELECT room_id FROM RoomCounts) "
-            "AND crm.user_id = ANY($2::text[]) "
-            "GROUP BY cr.room_id "
-            "HAVING COUNT(*) = $1 "
-            "LIMIT 1;";
-        
-        // Convert vector to PostgreSQL array string
-        std::string array_str = "{";
-        for (size_t i = 0; i < sorted_user_ids.size(); ++i) {
-            if (i > 0) array_str += ",";
-            array_str += "\"" + sorted_user_ids[i] + "\"";
-        }
-        array_str += "}";
-        
+        sorted_user_ids.erase(std::unique(sorted_user_ids.begin(), sorted_user_ids.end()), sorted_user_ids.end());
+        if (sorted_user_ids.empty()) throw std::runtime_error("a room needs members");
+
+        PooledConnection dbConnection = createConnection();
+        pqxx::work txn(dbConnection);
+
         pqxx::result find_result = txn.exec_params(
-            find_query,
-            static_cast<int>(user_ids.size()),
-            array_str
+            queries::FIND_ROOM,
+            static_cast<int>(sorted_user_ids.size()),
+            toArrayLiteral(sorted_user_ids, 0, sorted_user_ids.size()),
+            sorted_user_ids.front()
         );
         
+        op.rows(find_result.size());
         if (!find_result.empty()) {
             std::string existing_room_id = find_result[0][0].as<std::string>();
             return existing_room_id;
@@ -161,46 +433,97 @@ std::string DatabaseHandler::get_or_create_chat_room(const std::vector<std::stri
         uuid_unparse_lower(uuid, uuid_str);
         std::string room_id = std::string(uuid_str);
         
-        // Create new room with UUID
-        std::string create_room_query = 
-            "INSERT INTO chat_rooms (room_id, room_name) VALUES ($1, $2) "
-            "RETURNING room_id;";
-
-        std::cout << "Generated room_id: " << room_id << " (length: " << room_id.length() << ")" << std::endl;
-            
-        pqxx::result create_result = txn.exec_params(create_room_query, room_id, room_name);
-        
-        std::string add_members_query =
-            "INSERT INTO chat_room_members (room_id, user_id) "
-            "SELECT $1, unnest($2::text[]);";
-        txn.exec_params(add_members_query, room_id, array_str);
-        txn.commit();
+        // Members go in batches, so a large group never turns into one huge statement
+        auto for_each_batch = [&](const std::vector<std::string>& values,
+                                  const std::function<void(const std::string&)>& insert) {
+            for (std::size_t begin = 0; begin < values.size(); begin += MEMBER_INSERT_BATCH) {
+                insert(toArrayLiteral(values, begin, std::min(values.size(), begin + MEMBER_INSERT_BATCH)));
+            }
+        };
 
-        std::cout << "Add members query: " << add_members_query << std::endl;
+        if (shards.empty()) {
+            txn.exec_params(queries::CREATE_ROOM, room_id, room_name);
+            for_each_batch(sorted_user_ids, [&](const std::string& batch) {
+                txn.exec_params(queries::ADD_ROOM_MEMBERS, room_id, batch);
+                txn.exec_params(queries::ADD_ROOM_DIRECTORY, batch, room_id);
+            });
+            txn.commit();
+            recordWrite(dbConnection);
+        } else {
+            // The room lives on its shard, with a copy of its members' usernames for the joins there
+            PooledConnection shardConnection = createRoomConnection(room_id, "get_or_create_chat_room");
+            pqxx::work shard_txn(shardConnection);
+            std::vector<std::string> member_ids;
+            std::vector<std::string> member_names;
+            for_each_batch(sorted_user_ids, [&](const std::string& batch) {
+                pqxx::result members = txn.exec_params(queries::USERS_BY_ID, batch);
+                for (const auto& member : members) {
+                    member_ids.push_back(member[0].as<std::string>());
+                    member_names.push_back(member[1].as<std::string>());
+                }
+            });
+            for (std::size_t begin = 0; begin < member_ids.size(); begin += MEMBER_INSERT_BATCH) {
+                std::size_t end = std::min(member_ids.size(), begin + MEMBER_INSERT_BATCH);
+                shard_txn.exec_params(
+                    queries::COPY_USERS,
+                    toArrayLiteral(member_ids, begin, end), toArrayLiteral(member_names, begin, end)
+                );
+            }
+            shard_txn.exec_params(queries::CREATE_ROOM, room_id, room_name);
+            for_each_batch(sorted_user_ids, [&](const std::string& batch) {
+                shard_txn.exec_params(queries::ADD_ROOM_MEMBERS, room_id, batch);
+                txn.exec_params(queries::ADD_ROOM_DIRECTORY, batch, room_id);
+            });
+
+            // Both sides are written before either commits, and the directory commits last.
+            // There is no distributed transaction: when the directory commit fails the room
+            // is deleted from its shard again, unless the commit may have gone through.
+            shard_txn.commit();
+            try {
+                txn.commit();
+            } catch (const pqxx::in_doubt_error&) {
+                throw;
+            } catch (const std::exception&) {
+                deleteShardRoom(room_id);
+                throw;
+            }
+        }
 
         return room_id;
         
     } catch (const std::exception& e) {
+        op.fail();
         std::cerr << "ERROR in get_or_create_chat_room: " << e.what() << std::endl;
         throw std::runtime_error("Failed to get or create chat room: " + std::string(e.what()));
     }
 }
 
+// PostgreSQL array literal of values[begin, end), elements quoted and escaped
+std::string DatabaseHandler::toArrayLiteral(const std::vector<std::string>& values, std::size_t begin, std::size_t end) {
+    std::string array_str = "{";
+    for (std::size_t i = begin; i < end; ++i) {
+        if (i > begin) array_str += ",";
+        array_str += "\"";
+        for (char c : values[i]) {
+            if (c == '"' || c == '\\') array_str += '\\';
+            array_str += c;
+        }
+        array_str += "\"";
+    }
+    array_str += "}";
+    return array_str;
+}
+
 // Method to get all users except the current user
 std::map<std::string, std::string> DatabaseHandler::get_all_users_except(const std::string& current_user_id) {
     std::map<std::string, std::string> users;
+    QueryMetrics::Scope op(query_metrics.operation("get_all_users_except"));
     try {
-        pqxx::connection dbConnection = createConnection();
+        PooledConnection dbConnection = createReadConnection("get_all_users_except");
         pqxx::work txn(dbConnection);
 
-        std::string query = R"(
-            SELECT user_id, username
-            FROM users
-            WHERE user_id != $1
-            ORDER BY username;
-        )";
-        
-        pqxx::result result = txn.exec_params(query, current_user_id);
+        pqxx::result result = txn.exec_params(queries::ALL_USERS_EXCEPT, current_user_id);
+        op.rows(result.size());
         
         for (const auto& row : result) {
             std::string user_id = row[0].as<std::string>();
@@ -211,6 +534,7 @@ std::map<std::string, std::string> DatabaseHandler::get_all_users_except(const s
         txn.commit();
         
     } catch (const std::exception& e) {
+        op.fail();
         throw std::runtime_error("Failed to get users: " + std::string(e.what()));
     }
     
@@ -219,51 +543,398 @@ std::map<std::string, std::string> DatabaseHandler::get_all_users_except(const s
 
 // Method to get messages from a specific room
 std::vector<Message> DatabaseHandler::get_room_messages(const std::string& room_id) {
+    return history_flight.run(room_id, query_metrics.operation("get_room_messages"),
+                              [&]() { return fetch_room_messages(room_id); });
+}
+
+std::vector<Message> DatabaseHandler::fetch_room_messages(const std::string& room_id) {
     std::vector<Message> messages;
+    QueryMetrics::Scope op(query_metrics.operation("get_room_messages"));
     try {
-        pqxx::connection dbConnection = createConnection();
+        PooledConnection dbConnection = createRoomReadConnection(room_id, "get_room_messages");
         pqxx::work txn(dbConnection);
         
-        std::string query = R"(
-            SELECT message_id, content, sender_id, timestamp, is_read
-            FROM messages
-            WHERE room_id = $1
-            ORDER BY timestamp ASC;
-        )";
+        pqxx::result result = txn.exec_params(queries::ROOM_HISTORY, room_id);
+        op.rows(result.size());
+        messages = toMessages(result);
         
-        pqxx::result result = txn.exec_params(query, room_id);
-        
-        for (const auto& row : result) {
-            messages.emplace_back(
-                row["message_id"].as<std::string>(),     
-                row["content"].as<std::string>(),        
-                row["sender_id"].as<std::string>(),      
-                parseTimestamp(row["timestamp"].as<std::string>()), 
-                row["is_read"].as<bool>()                
-            );
+        // Mark messages as read for the current user, on the primary when reading from a replica
+        if (replicas.empty()) {
+            txn.exec_params(queries::MARK_ROOM_READ, room_id);
+            txn.commit();
+        } else {
+            txn.commit();
+            mark_room_messages_read(room_id);
         }
         
-        // Mark messages as read for the current user
-        std::string update_query = R"(
-            UPDATE messages
-            SET is_read = TRUE
-            WHERE room_id = $1 AND is_read = FALSE;
-        )";
-        
-        txn.exec_params(update_query, room_id);
-        txn.commit();
-        
     } catch (const std::exception& e) {
+        op.fail();
         throw std::runtime_error("Failed to get room messages: " + std::string(e.what()));
     }
     
     return messages;
 }
 
-// Method to send a new message
-void DatabaseHandler::send_message(const std::string room_id, const std::string& sender_id, const std::string& content) {
+// Method to stream the history of a room newest first through a server-side cursor.
+// Each chunk holds its rows oldest first and is handed over before the next FETCH,
+// so only one chunk is in memory. on_chunk returns false to stop early. Only reads, the
+// room was marked read when it was opened (open_room).
+void DatabaseHandler::stream_room_messages(const std::string& room_id, std::size_t first_chunk_rows, std::size_t chunk_rows,
+                                           const std::function<bool(MessageStore&&)>& on_chunk,
+                                           const std::string& before_message_id,
+                                           std::chrono::system_clock::time_point before_time, CancellationToken* cancel) {
+    QueryMetrics::Scope op(query_metrics.operation("stream_room_messages"));
     try {
-        pqxx::connection dbConnection = createConnection();
+        PooledConnection dbConnection = createRoomReadConnection(room_id, "stream_room_messages");
+        CancellationToken::Binding binding(cancel, dbConnection);
+        pqxx::work txn(dbConnection);
+
+        // Without a starting message the stream begins with the newest one. Its timestamp
+        // bounds the lookup as in queries::MESSAGES_BEFORE, so only its month is probed.
+        std::string before_clause;
+        if (!before_message_id.empty()) {
+            std::string before_ts = txn.quote(formatTimestamp(before_time)) + "::timestamp";
+            std::string anchor = "FROM messages WHERE message_id = " + txn.quote(before_message_id) +
+                                 " AND timestamp BETWEEN " + before_ts + " - INTERVAL '1 day' AND " +
+                                 before_ts + " + INTERVAL '1 day'";
+            before_clause = " AND timestamp <= " + before_ts + " + INTERVAL '1 day'"
+                            " AND timestamp <= (SELECT timestamp " + anchor + ")"
+                            " AND (timestamp, message_id) < (SELECT timestamp, message_id " + anchor + ")";
+        }
+
+        txn.exec(
+            "DECLARE history_cursor NO SCROLL CURSOR FOR "
+            "SELECT message_id, content, sender_id, timestamp, is_read "
+            "FROM messages WHERE room_id = " + txn.quote(room_id) + before_clause +
+            " ORDER BY timestamp DESC, message_id DESC"
+        );
+
+        std::size_t rows = first_chunk_rows;
+        while (true) {
+            pqxx::result result = txn.exec("FETCH FORWARD " + std::to_string(rows) + " FROM history_cursor");
+            op.rows(result.size());
+            if (result.empty()) break;
+
+            MessageStore chunk;
+            for (const auto& row : result) {
+                chunk.prepend(
+                    std::string_view(row[0].c_str(), row[0].size()),
+                    std::string_view(row[1].c_str(), row[1].size()),
+                    std::string_view(row[2].c_str(), row[2].size()),
+                    room_id,
+                    parseTimestampSeconds(std::string_view(row[3].c_str(), row[3].size())),
+                    row[4].as<bool>()
+                );
+            }
+
+            bool more = result.size() == rows;
+            if (!on_chunk(std::move(chunk)) || !more) break;
+            if (cancel) cancel->throw_if_cancelled();
+            rows = chunk_rows;
+        }
+        txn.exec("CLOSE history_cursor");
+        txn.commit();
+
+    } catch (const std::exception& e) {
+        // A query aborted on purpose is not a failure
+        if (cancel && cancel->is_cancelled()) throw OperationCancelled();
+        op.fail();
+        throw std::runtime_error("Failed to stream room messages: " + std::string(e.what()));
+    }
+}
+
+// Method to get what a room view first displays. Identical concurrent opens (a room
+// opened again while loading, the same prefetch twice) share one load. A load cancelled
+// by the caller that started it is started again for the callers that were not cancelled.
+RoomSnapshot DatabaseHandler::open_room(const std::string& room_id, const std::string& viewer_id, int page_size, bool mark_read,
+                                        CancellationToken* cancel) {
+    while (true) {
+        try {
+            return open_room_flight.run({room_id, viewer_id, page_size, mark_read}, query_metrics.operation("open_room"),
+                                        [&]() { return fetch_open_room(room_id, viewer_id, page_size, mark_read, cancel); });
+        } catch (const OperationCancelled&) {
+            if (cancel && cancel->is_cancelled()) throw;
+        }
+    }
+}
+
+// The queries are sent together through a pipeline outside of an explicit transaction
+// (no BEGIN/COMMIT round trips), so the whole batch costs about one round trip instead
+// of one per query
+RoomSnapshot DatabaseHandler::fetch_open_room(const std::string& room_id, const std::string& viewer_id, int page_size,
+                                              bool mark_read, CancellationToken* cancel) {
+    RoomSnapshot snapshot;
+    QueryMetrics::Scope op(query_metrics.operation("open_room"));
+    std::uint64_t cache_epoch = room_cache.current_epoch();
+    std::optional<RoomInfo> cached = room_cache.get(room_id, viewer_id);
+    try {
+        PooledConnection dbConnection = mark_read ? createRoomConnection(room_id, "open_room")
+                                                     : createRoomReadConnection(room_id, "open_room");
+        CancellationToken::Binding binding(cancel, dbConnection);
+        pqxx::nontransaction txn(dbConnection);
+        pqxx::pipeline pipe(txn);
+
+        // A room already seen only costs its messages
+        std::optional<pqxx::pipeline::query_id> info_query;
+        if (!cached) info_query = pipe.insert(roomInfoQuery(txn, room_id, viewer_id));
+
+        // One extra row tells whether earlier messages exist
+        auto messages_query = pipe.insert(queries::latest_messages(txn.quote(room_id), page_size + 1));
+
+        // The page is read before the update, so it still shows what was unread
+        if (mark_read) {
+            pipe.insert("UPDATE messages SET is_read = TRUE WHERE room_id = " + txn.quote(room_id) + " AND is_read = FALSE");
+        }
+        pipe.complete();
+
+        if (info_query) {
+            pqxx::result info_rows = pipe.retrieve(*info_query);
+            op.rows(info_rows.size());
+            cached = toRoomInfo(info_rows);
+            // Replicas may lag behind the notifications, only primary reads are cached
+            if (mark_read) room_cache.put(room_id, viewer_id, *cached, cache_epoch);
+        }
+        snapshot.room_name = cached->room_name;
+        snapshot.members = cached->members;
+
+        pqxx::result messages = pipe.retrieve(messages_query);
+        op.rows(messages.size());
+        snapshot.messages = toMessages(messages);
+        snapshot.has_earlier_messages = snapshot.messages.size() > static_cast<std::size_t>(page_size);
+        if (snapshot.has_earlier_messages) snapshot.messages.pop_back();
+        std::reverse(snapshot.messages.begin(), snapshot.messages.end());
+
+    } catch (const std::exception& e) {
+        if (cancel && cancel->is_cancelled()) throw OperationCancelled();
+        op.fail();
+        throw std::runtime_error("Failed to open room: " + std::string(e.what()));
+    }
+
+    return snapshot;
+}
+
+// Create the monthly messages partitions ahead of time, on every database holding messages.
+// Archiving the old months is left to the operator (tools/archive_messages.cpp).
+int DatabaseHandler::maintain_message_partitions(int months_ahead) {
+    int created = 0;
+    QueryMetrics::Scope op(query_metrics.operation("maintain_message_partitions"));
+    try {
+        for (std::size_t shard = 0; shard < room_database_count(); ++shard) {
+            pqxx::connection dbConnection = createRoomDatabaseConnection(shard);
+            pqxx::work txn(dbConnection);
+
+            pqxx::result result = txn.exec_params("SELECT ensure_message_partitions($1);", months_ahead);
+            created += result[0][0].as<int>();
+            txn.commit();
+        }
+        op.rows(created);
+
+    } catch (const std::exception& e) {
+        op.fail();
+        throw std::runtime_error("Failed to maintain message partitions: " + std::string(e.what()));
+    }
+
+    return created;
+}
+
+// Method to get the messages of a room posted after a given message
+std::vector<Message> DatabaseHandler::get_room_messages_after(const std::string& room_id, const std::string& after_message_id,
+                                                              std::chrono::system_clock::time_point after_time, int limit) {
+    if (after_message_id.empty()) return get_room_messages(room_id);
+
+    std::vector<Message> messages;
+    QueryMetrics::Scope op(query_metrics.operation("get_room_messages_after"));
+    try {
+        PooledConnection dbConnection = createRoomReadConnection(room_id, "get_room_messages_after");
+        pqxx::work txn(dbConnection);
+
+        pqxx::result result = txn.exec_params(queries::MESSAGES_AFTER, room_id, after_message_id,
+                                              formatTimestamp(after_time), limit);
+        op.rows(result.size());
+        messages = toMessages(result);
+
+        // Only touch the rows when something new arrived, on the primary when reading from a replica
+        if (!messages.empty() && replicas.empty()) {
+            txn.exec_params(queries::MARK_ROOM_READ, room_id);
+        }
+        txn.commit();
+        if (!messages.empty() && !replicas.empty()) mark_room_messages_read(room_id);
+
+    } catch (const std::exception& e) {
+        op.fail();
+        throw std::runtime_error("Failed to get new room messages: " + std::string(e.what()));
+    }
+
+    return messages;
+}
+
+// Method to get the page of messages preceding a given message, oldest first
+std::vector<Message> DatabaseHandler::get_room_messages_before(const std::string& room_id, const std::string& before_message_id,
+                                                               std::chrono::system_clock::time_point before_time, int limit) {
+    std::vector<Message> messages;
+    QueryMetrics::Scope op(query_metrics.operation("get_room_messages_before"));
+    try {
+        PooledConnection dbConnection = createRoomReadConnection(room_id, "get_room_messages_before");
+        pqxx::work txn(dbConnection);
+
+        pqxx::result result = txn.exec_params(queries::MESSAGES_BEFORE, room_id, before_message_id,
+                                              formatTimestamp(before_time), limit);
+        op.rows(result.size());
+        messages = toMessages(result);
+        std::reverse(messages.begin(), messages.end());
+        txn.commit();
+
+    } catch (const std::exception& e) {
+        op.fail();
+        throw std::runtime_error("Failed to get earlier room messages: " + std::string(e.what()));
+    }
+
+    return messages;
+}
+
+// Page of history centered on a message, for opening a room at a search result. The message
+// and the ones before it come from one backward scan, the ones after from one forward scan,
+// each with an extra row telling whether the history goes on.
+RoomSnapshot DatabaseHandler::get_room_messages_around(const std::string& room_id, const std::string& message_id,
+                                                       int page_size) {
+    RoomSnapshot window;
+    QueryMetrics::Scope op(query_metrics.operation("get_room_messages_around"));
+    try {
+        PooledConnection dbConnection = createRoomReadConnection(room_id, "get_room_messages_around");
+        pqxx::work txn(dbConnection);
+
+        int before_count = page_size / 2;
+        int after_count = page_size - before_count;
+        pqxx::result result = txn.exec_params(queries::MESSAGES_AROUND, room_id, message_id, before_count + 1, after_count + 1);
+        op.rows(result.size());
+        txn.commit();
+        window = toWindow(result, before_count, after_count);
+
+    } catch (const std::exception& e) {
+        op.fail();
+        throw std::runtime_error("Failed to get room messages around a message: " + std::string(e.what()));
+    }
+
+    return window;
+}
+
+// Page of history starting at a date: the first message at or after it and the following
+// ones, preceded by the ones just before. Both halves are a descent of messages_room_timestamp
+// to (room_id, when) then a short scan, and each half prunes the months on the other side of
+// the date, so the seek costs the same for last week and for years ago.
+RoomSnapshot DatabaseHandler::get_room_messages_at(const std::string& room_id,
+                                                   std::chrono::system_clock::time_point when, int page_size) {
+    RoomSnapshot window;
+    QueryMetrics::Scope op(query_metrics.operation("get_room_messages_at"));
+    try {
+        PooledConnection dbConnection = createRoomReadConnection(room_id, "get_room_messages_at");
+        pqxx::work txn(dbConnection);
+
+        int before_count = page_size / 2;
+        int after_count = page_size - before_count;
+        pqxx::result result = txn.exec_params(queries::MESSAGES_AT, room_id, formatTimestamp(when), before_count + 1, after_count + 1);
+        op.rows(result.size());
+        txn.commit();
+        window = toWindow(result, before_count, after_count);
+
+    } catch (const std::exception& e) {
+        op.fail();
+        throw std::runtime_error("Failed to get room messages at a date: " + std::string(e.what()));
+    }
+
+    return window;
+}
+
+// Split rows flagged after_anchor (oldest first, one extra row) from the ones before the
+// anchor (newest first, one extra row) into a page in order
+RoomSnapshot DatabaseHandler::toWindow(const pqxx::result& result, int before_count, int after_count) {
+    RoomSnapshot window;
+    std::vector<Message> messages = toMessages(result);
+    std::vector<Message> later;
+    for (std::size_t i = 0; i < messages.size(); ++i) {
+        if (result[i]["after_anchor"].as<bool>()) {
+            later.push_back(std::move(messages[i]));
+        } else {
+            window.messages.push_back(std::move(messages[i]));
+        }
+    }
+    window.has_earlier_messages = window.messages.size() > static_cast<std::size_t>(before_count);
+    if (window.has_earlier_messages) window.messages.pop_back();
+    std::reverse(window.messages.begin(), window.messages.end());
+
+    window.has_later_messages = later.size() > static_cast<std::size_t>(after_count);
+    if (window.has_later_messages) later.pop_back();
+    for (auto& msg : later) window.messages.push_back(std::move(msg));
+    return window;
+}
+
+// Ranked full-text search over the messages of the user's rooms. Matches are found through
+// the messages_content_tsv GIN index, then ranked, pages follow on (rank, message_id).
+// Ids compare bytewise (COLLATE "C") so the pages of several shards merge the same way.
+std::vector<SearchResult> DatabaseHandler::search_messages(const std::string& user_id, const std::string& terms,
+                                                           int limit, const SearchResult* after) {
+    std::vector<SearchResult> results;
+    QueryMetrics::Scope op(query_metrics.operation("search_messages"));
+    try {
+        float after_rank = after ? after->rank : 0;
+        std::string after_message_id = after ? after->message_id : "";
+
+        // Every shard returns its own best page, the overall best page is among them
+        std::vector<pqxx::result> shard_results = queryAllShards("search_messages", [&](pqxx::work& txn) {
+            return txn.exec_params(queries::SEARCH_MESSAGES, user_id, terms, after_rank, after_message_id, limit);
+        });
+
+        for (const auto& result : shard_results) {
+            op.rows(result.size());
+            for (const auto& row : result) {
+                SearchResult hit;
+                hit.message_id = row["message_id"].as<std::string>();
+                hit.room_id = row["room_id"].as<std::string>();
+                hit.room_name = row["room_name"].as<std::string>();
+                hit.sender_name = row["username"].as<std::string>();
+                hit.content = row["content"].as<std::string>();
+                hit.timestamp = parseTimestamp(row["timestamp"].as<std::string>());
+                hit.rank = row["rank"].as<float>();
+                results.push_back(std::move(hit));
+            }
+        }
+        if (shard_results.size() > 1) {
+            std::sort(results.begin(), results.end(), [](const SearchResult& a, const SearchResult& b) {
+                return a.rank != b.rank ? a.rank > b.rank : a.message_id > b.message_id;
+            });
+            if (results.size() > static_cast<std::size_t>(limit)) results.resize(limit);
+        }
+
+    } catch (const std::exception& e) {
+        op.fail();
+        throw std::runtime_error("Failed to search messages: " + std::string(e.what()));
+    }
+
+    return results;
+}
+
+void DatabaseHandler::mark_room_messages_read(const std::string& room_id) {
+    QueryMetrics::Scope op(query_metrics.operation("mark_room_messages_read"));
+    try {
+        PooledConnection dbConnection = createRoomConnection(room_id, "mark_room_messages_read");
+        pqxx::work txn(dbConnection);
+
+        pqxx::result result = txn.exec_params(queries::MARK_ROOM_READ, room_id);
+        op.rows(result.affected_rows());
+        txn.commit();
+        recordWrite(dbConnection);
+
+    } catch (const std::exception& e) {
+        op.fail();
+        throw std::runtime_error("Failed to mark messages as read: " + std::string(e.what()));
+    }
+}
+
+// Method to send a new message, returns its id
+std::string DatabaseHandler::send_message(const std::string room_id, const std::string& sender_id, const std::string& content) {
+    QueryMetrics::Scope op(query_metrics.operation("send_message"));
+    try {
+        PooledConnection dbConnection = createRoomConnection(room_id, "send_message");
         pqxx::work txn(dbConnection);
 
         // Generate a unique message ID
@@ -275,19 +946,33 @@ void DatabaseHandler::send_message(const std::string room_id, const std::string&
         uuid_unparse_lower(uuid, uuid_str);
         message_id = std::string(uuid_str);
         
-        std::string query = R"(
-            INSERT INTO messages (message_id, content, sender_id, room_id)
-            VALUES ($1, $2, $3, $4);
-        )";
-        
-        txn.exec_params(query, message_id, content, sender_id, room_id);
+        txn.exec_params(queries::INSERT_MESSAGE, message_id, content, sender_id, room_id);
         txn.commit();
+        recordWrite(dbConnection);
+
+        return message_id;
         
     } catch (const std::exception& e) {
+        op.fail();
         throw std::runtime_error("Failed to send message: " + std::string(e.what()));
     }
 }
 
+std::vector<Message> DatabaseHandler::toMessages(const pqxx::result& result) {
+    std::vector<Message> messages;
+    messages.reserve(result.size());
+    for (const auto& row : result) {
+        messages.emplace_back(
+            row["message_id"].as<std::string>(),
+            row["content"].as<std::string>(),
+            row["sender_id"].as<std::string>(),
+            parseTimestamp(row["timestamp"].as<std::string>()),
+            row["is_read"].as<bool>()
+        );
+    }
+    return messages;
+}
+
 std::chrono::system_clock::time_point DatabaseHandler::parseTimestamp(const std::string& timestamp_str) {
     std::tm tm = {};
     std::stringstream ss(timestamp_str);
@@ -295,17 +980,53 @@ std::chrono::system_clock::time_point DatabaseHandler::parseTimestamp(const std:
     return std::chrono::system_clock::from_time_t(std::mktime(&tm));
 }
 
+// Inverse of parseTimestamp, local time as stored by NOW()
+std::string DatabaseHandler::formatTimestamp(std::chrono::system_clock::time_point time) {
+    std::time_t seconds = std::chrono::system_clock::to_time_t(time);
+    std::tm tm = {};
+    localtime_r(&seconds, &tm);
+    std::ostringstream formatted;
+    formatted << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
+    return formatted.str();
+}
+
+// Same result as parseTimestamp ("YYYY-MM-DD HH:MM:SS", fractional part ignored)
+// without going through a stream, for bulk loads
+std::int64_t DatabaseHandler::parseTimestampSeconds(std::string_view timestamp_str) {
+    auto number = [&timestamp_str](std::size_t position, std::size_t length) {
+        int value = 0;
+        for (std::size_t i = position; i < position + length && i < timestamp_str.size(); ++i) {
+            if (timestamp_str[i] < '0' || timestamp_str[i] > '9') break;
+            value = value * 10 + (timestamp_str[i] - '0');
+        }
+        return value;
+    };
+
+    std::tm tm = {};
+    tm.tm_year = number(0, 4) - 1900;
+    tm.tm_mon = number(5, 2) - 1;
+    tm.tm_mday = number(8, 2);
+    tm.tm_hour = number(11, 2);
+    tm.tm_min = number(14, 2);
+    tm.tm_sec = number(17, 2);
+    return static_cast<std::int64_t>(std::mktime(&tm));
+}
+
 std::string DatabaseHandler::get_username_by_id(const std::string& user_id) {
+    return username_flight.run(user_id, query_metrics.operation("get_username_by_id"),
+                               [&]() { return fetch_username_by_id(user_id); });
+}
+
+std::string DatabaseHandler::fetch_username_by_id(const std::string& user_id) {
+    QueryMetrics::Scope op(query_metrics.operation("get_username_by_id"));
     try {
-        pqxx::connection dbConnection = createConnection();
+        PooledConnection dbConnection = createReadConnection("get_username_by_id");
         pqxx::work txn(dbConnection);
         
         // Using parameterized query to prevent SQL injection
-        pqxx::result result = txn.exec_params(
-            "SELECT username FROM users WHERE user_id = $1",
-            user_id
-        );
+        pqxx::result result = txn.exec_params(queries::USERNAME_BY_ID, user_id);
         
+        op.rows(result.size());
         if (result.empty()) {
             throw std::runtime_error("User not found");
         }
@@ -315,41 +1036,100 @@ std::string DatabaseHandler::get_username_by_id(const std::string& user_id) {
         
         return username;
     } catch (const std::exception& e) {
+        op.fail();
         throw std::runtime_error("Error getting username: " + std::string(e.what()));
     }
 }
 
-std::vector<std::string> DatabaseHandler::get_room_users(const std::string& room_id) {
-    std::vector<std::string> usernames;
+// Usernames of several users in one query, the unknown ids are left out
+std::map<std::string, std::string> DatabaseHandler::get_usernames_by_id(const std::vector<std::string>& user_ids) {
+    std::map<std::string, std::string> usernames;
+    if (user_ids.empty()) return usernames;
+    QueryMetrics::Scope op(query_metrics.operation("get_usernames_by_id"));
     try {
-        pqxx::connection dbConnection = createConnection();
+        PooledConnection dbConnection = createReadConnection("get_usernames_by_id");
         pqxx::work txn(dbConnection);
-        
-        std::string query = R"(
-            SELECT DISTINCT u.username 
-            FROM users u 
-            INNER JOIN chat_room_members crm ON u.user_id = crm.user_id 
-            WHERE crm.room_id = $1 
-            AND u.user_id != $2 
-            ORDER BY u.username;
-        )";
-        
-        pqxx::result result = txn.exec_params(query, room_id, current_user->getUserId());
-        
+
+        pqxx::result result = txn.exec_params(queries::USERS_BY_ID, toArrayLiteral(user_ids, 0, user_ids.size()));
+        op.rows(result.size());
         for (const auto& row : result) {
-            usernames.push_back(row["username"].as<std::string>());
+            usernames.emplace(row[0].as<std::string>(), row[1].as<std::string>());
         }
+        txn.commit();
+    } catch (const std::exception& e) {
+        op.fail();
+        throw std::runtime_error("Error getting usernames: " + std::string(e.what()));
+    }
+    return usernames;
+}
 
-        // If no other users found, return appropriate message
-        if (usernames.empty()) {
-            usernames.push_back("no other users");
-        }
+RoomInfo DatabaseHandler::get_room_info(const std::string& room_id) {
+    return get_room_info(room_id, getCurrentUser().getUserId());
+}
+
+// Name of a room, how many other members it has and the first few of their names
+RoomInfo DatabaseHandler::get_room_info(const std::string& room_id, const std::string& viewer_id) {
+    std::uint64_t cache_epoch = room_cache.current_epoch();
+    if (auto cached = room_cache.get(room_id, viewer_id)) return *cached;
 
+    RoomInfo info = room_info_flight.run({room_id, viewer_id}, query_metrics.operation("get_room_info"),
+                                         [&]() { return fetch_room_info(room_id, viewer_id); });
+    room_cache.put(room_id, viewer_id, info, cache_epoch);
+    return info;
+}
+
+// Read from the primary, a replica could still miss a change already notified
+RoomInfo DatabaseHandler::fetch_room_info(const std::string& room_id, const std::string& viewer_id) {
+    QueryMetrics::Scope op(query_metrics.operation("get_room_info"));
+    try {
+        PooledConnection dbConnection = createRoomConnection(room_id, "get_room_info");
+        pqxx::nontransaction txn(dbConnection);
+        pqxx::result result = txn.exec(roomInfoQuery(txn, room_id, viewer_id));
+        op.rows(result.size());
+        return toRoomInfo(result);
+    } catch (const std::exception& e) {
+        op.fail();
+        throw std::runtime_error("Failed to get room info: " + std::string(e.what()));
+    }
+}
+
+// Shared with the plan check, see queries::room_info
+std::string DatabaseHandler::roomInfoQuery(pqxx::transaction_base& txn, const std::string& room_id,
+                                           const std::string& viewer_id) {
+    return queries::room_info(txn.quote(room_id), txn.quote(viewer_id), MEMBER_SUMMARY_NAMES);
+}
+
+RoomInfo DatabaseHandler::toRoomInfo(const pqxx::result& result) {
+    RoomInfo info;
+    for (const auto& row : result) {
+        info.room_name = row["room_name"].as<std::string>();
+        info.members.count = row["member_count"].as<std::size_t>();
+        if (!row["username"].is_null()) info.members.first_names.push_back(row["username"].as<std::string>());
+    }
+    std::sort(info.members.first_names.begin(), info.members.first_names.end());
+    return info;
+}
+
+// Keyset on user_id, the order of chat_room_members_pkey, a page never rereads the ones before it
+std::vector<RoomMember> DatabaseHandler::get_room_members_page(const std::string& room_id, const std::string& viewer_id,
+                                                               const std::string& after_user_id, int limit) {
+    std::vector<RoomMember> members;
+    QueryMetrics::Scope op(query_metrics.operation("get_room_members_page"));
+    try {
+        PooledConnection dbConnection = createRoomReadConnection(room_id, "get_room_members_page");
+        pqxx::work txn(dbConnection);
+
+        pqxx::result result = txn.exec_params(queries::ROOM_MEMBERS_PAGE, room_id, viewer_id, after_user_id, limit);
+        op.rows(result.size());
+        for (const auto& row : result) {
+            members.push_back(RoomMember{row["user_id"].as<std::string>(), row["username"].as<std::string>()});
+        }
         txn.commit();
-        
+
     } catch (const std::exception& e) {
-        throw std::runtime_error("Failed to get room users: " + std::string(e.what()));
+        op.fail();
+        throw std::runtime_error("Failed to get room members: " + std::string(e.what()));
     }
-    
-    return usernames;
+
+    return members;
 }
\ No newline at end of file
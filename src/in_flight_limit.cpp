@@ -0,0 +1,28 @@
+#include "in_flight_limit.h"
+
+InFlightLimit::InFlightLimit(std::size_t limit) : limit(limit > 0 ? limit : 1) {
+}
+
+bool InFlightLimit::acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    released.wait(lock, [this]() { return closed || in_flight < limit; });
+    if (closed) return false;
+    ++in_flight;
+    return true;
+}
+
+void InFlightLimit::release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (in_flight > 0) --in_flight;
+    }
+    released.notify_one();
+}
+
+void InFlightLimit::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    released.notify_all();
+}
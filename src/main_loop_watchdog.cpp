@@ -0,0 +1,33 @@
+#include "main_loop_watchdog.h"
+#include "tracer.h"
+#include <iostream>
+
+MainLoopWatchdog::MainLoopWatchdog(std::chrono::milliseconds frame_budget)
+    : frame_budget(frame_budget), last_tick(std::chrono::steady_clock::now()) {
+    timer = Glib::signal_timeout().connect(
+        sigc::mem_fun(*this, &MainLoopWatchdog::on_tick),
+        static_cast<unsigned int>(frame_budget.count()),
+        Glib::PRIORITY_HIGH
+    );
+}
+
+MainLoopWatchdog::~MainLoopWatchdog() {
+    timer.disconnect();
+}
+
+bool MainLoopWatchdog::on_tick() {
+    auto now = std::chrono::steady_clock::now();
+    auto lateness = now - last_tick - frame_budget;
+
+    if (lateness > frame_budget) {
+        ++stall_count;
+        auto stall_ms = std::chrono::duration_cast<std::chrono::milliseconds>(lateness).count();
+        std::cerr << "Main loop stalled for " << stall_ms << " ms" << std::endl;
+
+        // The stall ended now and started when the timer should have fired
+        Tracer::instance().record_span("main-loop-stall", "watchdog", now - lateness, now);
+    }
+
+    last_tick = now;
+    return true;
+}
@@ -1,4 +1,5 @@
 #include "main_window.h"
+#include <cstdlib>
 
 MainWindow::MainWindow(DatabaseHandler& db) : db_handler(db) {
     set_title("vaoApp");
@@ -26,12 +27,23 @@ MainWindow::MainWindow(DatabaseHandler& db) : db_handler(db) {
     // Show login by default
     main_stack.set_visible_child("login");
     
+    // Away while another window has the focus
+    signal_focus_in_event().connect([this](GdkEventFocus*) {
+        if (presence) presence->set_away(false);
+        return false;
+    });
+    signal_focus_out_event().connect([this](GdkEventFocus*) {
+        if (presence) presence->set_away(true);
+        return false;
+    });
+
     add(main_stack);
     show_all();
 }
 
 // On create new account clicked
 void MainWindow::on_create_account_requested() {
+    TraceSpan span("show-new-user-view");
 
     // Create new user view if it doesn't exist
     if (!new_user_view) {
@@ -50,12 +62,14 @@ void MainWindow::on_create_account_requested() {
 }
 
 void MainWindow::on_back_to_login() {
+    TraceSpan span("show-login-view");
     // Show login view with reverse transition
     main_stack.set_transition_type(Gtk::StackTransitionType::STACK_TRANSITION_TYPE_SLIDE_RIGHT);
     main_stack.set_visible_child("login");
 }
 
 void MainWindow::on_login_success() {
+    TraceSpan span("show-chat-list-view");
 
     // Connect signals
     chat_view = std::make_unique<ChatListView>(db_handler);
@@ -72,6 +86,35 @@ void MainWindow::on_login_success() {
     chat_view->signal_create_new_chat_room().connect(
         sigc::mem_fun(*this,&MainWindow::on_create_new_chat_room)
     );
+
+    // For message search
+    chat_view->signal_search_requested().connect(
+        sigc::mem_fun(*this, &MainWindow::on_search_requested)
+    );
+
+    // Rooms are cached once their changes are received
+    room_changes = std::make_unique<RoomChangeListener>(db_handler);
+    room_changes->signal_room_changed().connect(
+        sigc::mem_fun(*this, &MainWindow::on_room_changed)
+    );
+
+    // Start prefetching the most active rooms, then whatever gets hovered
+    prefetcher = std::make_unique<RoomPrefetcher>(db_handler, db_handler.getCurrentUser().getUserId());
+    prefetcher->prefetch_recent(PREFETCH_ROOM_COUNT);
+    chat_view->signal_room_hovered().connect(
+        sigc::mem_fun(*this, &MainWindow::on_room_hovered)
+    );
+
+    // Heartbeats every VAOAPP_PRESENCE_INTERVAL_MS (5 s by default)
+    auto presence_interval = PresenceService::DEFAULT_INTERVAL;
+    if (const char* interval = std::getenv("VAOAPP_PRESENCE_INTERVAL_MS")) {
+        if (std::atoi(interval) > 0) presence_interval = std::chrono::milliseconds(std::atoi(interval));
+    }
+    presence = std::make_unique<PresenceService>(db_handler, db_handler.getCurrentUser().getUserId(),
+                                                 presence_interval);
+    presence->signal_presence_changed().connect(
+        sigc::mem_fun(*this, &MainWindow::on_presence_changed)
+    );
     
     // Add chat view to stack and show it with transition
     main_stack.add(*chat_view, "chat");
@@ -87,6 +130,7 @@ void MainWindow::on_login_success() {
 }
 
 void MainWindow::on_logout() {
+    TraceSpan span("logout");
     // Show login view before transition
     login_view->show();
     
@@ -94,13 +138,28 @@ void MainWindow::on_logout() {
     main_stack.set_transition_type(Gtk::StackTransitionType::STACK_TRANSITION_TYPE_SLIDE_RIGHT);
     main_stack.set_visible_child("login");
     
-    // Cleanup chat view
+    // Cleanup chat view and the rooms of the previous user
+    presence.reset();
+    prefetcher.reset();
+    room_changes.reset();
     chat_view.reset();
+    clear_room_views();
+    if (search_view) {
+        main_stack.remove(*search_view);
+        search_view.reset();
+    }
+
+    // Built for the previous user, created again when needed
+    if (new_chat_room_view) {
+        main_stack.remove(*new_chat_room_view);
+        new_chat_room_view.reset();
+    }
     
     set_title("vaoApp");
 }
 
 void MainWindow::on_create_new_chat_room(){
+    TraceSpan span("show-new-chat-room-view");
     // Create new chat_room_view if it doesn't exist
     if (!new_chat_room_view) {
         new_chat_room_view = std::make_unique<NewChatRoomView>(db_handler);
@@ -110,6 +169,11 @@ void MainWindow::on_create_new_chat_room(){
         new_chat_room_view->signal_back_to_chat_list_requested().connect(
             sigc::mem_fun(*this, &MainWindow::on_back_to_chat_list)
         );
+
+        // Open the new room, listed first in the chat list
+        new_chat_room_view->signal_chat_room_created().connect(
+            sigc::mem_fun(*this, &MainWindow::on_chat_room_created)
+        );
     }
     
     // Show new_chat_room view with transition
@@ -117,24 +181,149 @@ void MainWindow::on_create_new_chat_room(){
     main_stack.set_visible_child("new-chatroom");
 }
 
+void MainWindow::on_chat_room_created(const std::string& room_id, const std::string& room_name) {
+    if (chat_view) chat_view->queue_room_activity(room_id, room_name);
+    on_open_chat_room(room_id, room_name);
+}
+
 void MainWindow::on_back_to_chat_list() {
+    TraceSpan span("back-to-chat-list");
+    if (presence) presence->set_room("");
     // Show login view with reverse transition
     main_stack.set_transition_type(Gtk::StackTransitionType::STACK_TRANSITION_TYPE_SLIDE_RIGHT);
     main_stack.set_visible_child("chat");
 }
 
 void MainWindow::on_open_chat_room(const std::string& room_id, const std::string& room_name) {
-    // Create new chat room view
-    chat_room_view = std::make_unique<ChatRoomView>(db_handler, room_id, room_name);
-    main_stack.add(*chat_room_view, "chat-room-" + room_name);
-    
-    // Show chat room view with transition
+    TraceSpan span("open-chat-room");
+    std::string child_name = "chat-room-" + room_id;
+
+    // A second activation while the room is already shown (double-click) is ignored
+    if (main_stack.get_visible_child_name() == child_name) return;
+    auto cached = room_views.find(room_id);
+
+    if (cached != room_views.end()) {
+        // Reuse the cached view, only fetch what was posted since
+        room_view_lru.remove(room_id);
+        room_view_lru.push_front(room_id);
+        cached->second->refresh();
+    } else {
+        // Create new chat room view, from the prefetched data when available
+        std::optional<RoomSnapshot> snapshot;
+        if (prefetcher) snapshot = prefetcher->take(room_id);
+        add_room_view(room_id, room_name, std::move(snapshot), "");
+    }
+
+    show_room(room_id);
+}
+
+void MainWindow::on_search_requested() {
+    TraceSpan span("show-search-view");
+    // Create the search view if it doesn't exist, it keeps the last results
+    if (!search_view) {
+        search_view = std::make_unique<SearchView>(db_handler);
+        main_stack.add(*search_view, "search");
+
+        search_view->signal_back_to_chat_list_requested().connect(
+            sigc::mem_fun(*this, &MainWindow::on_back_to_chat_list)
+        );
+        search_view->signal_open_search_result().connect(
+            sigc::mem_fun(*this, &MainWindow::on_open_search_result)
+        );
+    }
+
     main_stack.set_transition_type(Gtk::StackTransitionType::STACK_TRANSITION_TYPE_SLIDE_LEFT);
-    main_stack.set_visible_child("chat-room-" + room_name);
-    
+    main_stack.set_visible_child("search");
+}
+
+// The room opens on the page around the message, replacing a cached view of the latest history
+void MainWindow::on_open_search_result(const std::string& room_id, const std::string& room_name,
+                                       const std::string& message_id) {
+    TraceSpan span("open-search-result");
+    remove_room_view(room_id);
+    add_room_view(room_id, room_name, std::nullopt, message_id);
+    show_room(room_id);
+}
+
+// Show chat room view with transition
+void MainWindow::show_room(const std::string& room_id) {
+    if (presence) presence->set_room(room_id);
+    main_stack.set_transition_type(Gtk::StackTransitionType::STACK_TRANSITION_TYPE_SLIDE_LEFT);
+    main_stack.set_visible_child("chat-room-" + room_id);
+}
+
+void MainWindow::on_room_changed(const std::string& room_id) {
+    auto view = room_views.find(room_id);
+    if (view != room_views.end()) view->second->reload_room_info();
+}
+
+void MainWindow::on_presence_changed(const PresenceSnapshot& snapshot) {
+    if (chat_view) chat_view->show_presence(snapshot);
+    static const RoomPresence nobody;
+    for (auto& [room_id, view] : room_views) {
+        auto room = snapshot.find(room_id);
+        view->show_presence(room != snapshot.end() ? room->second : nobody);
+    }
+}
+
+void MainWindow::add_room_view(const std::string& room_id, const std::string& room_name,
+                               std::optional<RoomSnapshot> snapshot, const std::string& anchor_message_id) {
+    auto chat_room_view = std::make_unique<ChatRoomView>(db_handler, room_id, room_name, std::move(snapshot),
+                                                         anchor_message_id);
+    main_stack.add(*chat_room_view, "chat-room-" + room_id);
+
     // Connect back to chat list signal
-    chat_room_view->signal_back_to_chat_list_requested().connect([this]() {
-        main_stack.set_transition_type(Gtk::StackTransitionType::STACK_TRANSITION_TYPE_SLIDE_RIGHT);
-        main_stack.set_visible_child("chat");
+    chat_room_view->signal_back_to_chat_list_requested().connect(
+        sigc::mem_fun(*this, &MainWindow::on_back_to_chat_list)
+    );
+
+    // Keystrokes are coalesced by the presence service
+    chat_room_view->signal_typing().connect([this](const std::string& room_id, bool typing) {
+        if (presence) presence->set_typing(room_id, typing);
     });
+    if (presence) {
+        auto room = presence->snapshot().find(room_id);
+        if (room != presence->snapshot().end()) chat_room_view->show_presence(room->second);
+    }
+
+    // New messages move the room to the top of the chat list
+    chat_room_view->signal_room_activity().connect(
+        [this](const std::string& room_id, const std::string& room_name) {
+            if (chat_view) chat_view->queue_room_activity(room_id, room_name);
+        });
+
+    room_views.emplace(room_id, std::move(chat_room_view));
+    room_view_lru.push_front(room_id);
+    evict_room_views();
+}
+
+void MainWindow::on_room_hovered(const std::string& room_id) {
+    // Cached views are already instant to open
+    if (prefetcher && !room_views.count(room_id)) {
+        prefetcher->prefetch(room_id);
+    }
+}
+
+void MainWindow::remove_room_view(const std::string& room_id) {
+    room_view_lru.remove(room_id);
+    auto view = room_views.find(room_id);
+    if (view == room_views.end()) return;
+    main_stack.remove(*view->second);
+    room_views.erase(view);
+}
+
+// Drop the least recently opened rooms above the cache size
+void MainWindow::evict_room_views() {
+    while (room_view_lru.size() > ROOM_VIEW_CACHE_SIZE) {
+        std::string evicted_id = room_view_lru.back();
+        remove_room_view(evicted_id);
+    }
+}
+
+void MainWindow::clear_room_views() {
+    for (auto& [room_id, view] : room_views) {
+        main_stack.remove(*view);
+    }
+    room_views.clear();
+    room_view_lru.clear();
 }
\ No newline at end of file
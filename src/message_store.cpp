@@ -0,0 +1,65 @@
+#include "message_store.h"
+#include <algorithm>
+#include <cstring>
+
+// Arena
+Arena::Arena(std::size_t block_size) : block_size(block_size) {
+}
+
+std::string_view Arena::store(std::string_view bytes) {
+    if (bytes.size() > remaining) {
+        // Oversized strings get a block of their own
+        std::size_t size = std::max(block_size, bytes.size());
+        blocks.push_back(std::make_unique<char[]>(size));
+        cursor = blocks.back().get();
+        remaining = size;
+        reserved += size;
+    }
+
+    char* destination = cursor;
+    if (!bytes.empty()) std::memcpy(destination, bytes.data(), bytes.size());
+    cursor += bytes.size();
+    remaining -= bytes.size();
+    used += bytes.size();
+    return std::string_view(destination, bytes.size());
+}
+
+// Interner
+StringInterner::Handle StringInterner::intern(std::string_view text) {
+    auto found = handles.find(text);
+    if (found != handles.end()) return found->second;
+
+    std::string_view stored = arena.store(text);
+    auto handle = static_cast<Handle>(strings.size());
+    strings.push_back(stored);
+    handles.emplace(stored, handle);
+    return handle;
+}
+
+// Store
+MessageRow MessageStore::make_row(std::string_view message_id, std::string_view content,
+                                  std::string_view sender_id, std::string_view room_id,
+                                  std::int64_t timestamp, bool is_read) {
+    MessageRow row;
+    row.message_id = arena.store(message_id);
+    row.content = arena.store(content);
+    row.timestamp = timestamp;
+    row.sender = ids.intern(sender_id);
+    row.room = ids.intern(room_id);
+    row.is_read = is_read;
+    return row;
+}
+
+const MessageRow& MessageStore::append(std::string_view message_id, std::string_view content,
+                                       std::string_view sender_id, std::string_view room_id,
+                                       std::int64_t timestamp, bool is_read) {
+    newer_rows.push_back(make_row(message_id, content, sender_id, room_id, timestamp, is_read));
+    return newer_rows.back();
+}
+
+const MessageRow& MessageStore::prepend(std::string_view message_id, std::string_view content,
+                                        std::string_view sender_id, std::string_view room_id,
+                                        std::int64_t timestamp, bool is_read) {
+    older_rows.push_back(make_row(message_id, content, sender_id, room_id, timestamp, is_read));
+    return older_rows.back();
+}
@@ -200,10 +200,8 @@ void NewChatRoomView::on_confirm_clicked() {
         // Create the chat room
         std::string room_id = db_handler.get_or_create_chat_room(user_ids, room_name);
         
-        // Create and show chat room view
-        auto chat_room = new ChatRoomView(db_handler, room_id, room_name);
-
-        m_signal_back_to_chat_list_requested.emit();
+        // The main window opens it, like a room picked from the chat list
+        m_signal_chat_room_created.emit(room_id, room_name);
 
     } catch (const std::exception& e) {
         // Show error
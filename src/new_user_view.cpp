@@ -87,7 +87,7 @@ void NewUserView::on_create_clicked() {
         // Hash the password
         std::string hashedPassword = db_handler.hashPassword(password);
 
-        pqxx::connection dbConnection = db_handler.createConnection();
+        PooledConnection dbConnection = db_handler.createConnection();
         pqxx::work txn(dbConnection);
         
         // First check if username already exists
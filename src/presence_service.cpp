@@ -0,0 +1,179 @@
+#include "presence_service.h"
+
+PresenceService::PresenceService(DatabaseHandler& db, const std::string& user_id,
+                                 std::chrono::milliseconds interval, int ttl_intervals)
+    : db_handler(db), user_id(user_id), interval(interval), ttl(interval * ttl_intervals) {
+    dispatcher.connect(sigc::mem_fun(*this, &PresenceService::on_dispatch));
+    worker = std::thread(&PresenceService::run, this);
+}
+
+PresenceService::~PresenceService() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake_up.notify_one();
+    worker.join();
+}
+
+void PresenceService::set_room(const std::string& new_room_id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (room_id == new_room_id) return;
+        room_id = new_room_id;
+        typing_room_id.clear();
+        dirty = true;
+    }
+    wake_up.notify_one();
+}
+
+void PresenceService::set_away(bool new_away) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (away == new_away) return;
+        away = new_away;
+        dirty = true;
+    }
+    wake_up.notify_one();
+}
+
+// Keystrokes only go out when the typing state changes or is about to expire
+void PresenceService::set_typing(const std::string& typing_in, bool typing) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = std::chrono::steady_clock::now();
+        if (!typing) {
+            if (typing_room_id.empty()) return;
+            typing_room_id.clear();
+        } else {
+            if (typing_room_id == typing_in && now - typing_sent_at < TYPING_TTL / 2) return;
+            typing_room_id = typing_in;
+            typing_sent_at = now;
+        }
+        dirty = true;
+    }
+    wake_up.notify_one();
+}
+
+void PresenceService::run() {
+    std::uint64_t heartbeats = 0;
+    while (true) {
+        try {
+            // One connection for every heartbeat, opened again after a failure
+            PooledConnection dbConnection = db_handler.createConnection("presence_heartbeat");
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                // A heartbeat per interval, sooner when the state changed
+                if (!dirty) wake_up.wait_for(lock, interval, [this]() { return dirty || stopping; });
+                if (stopping) {
+                    lock.unlock();
+                    leave(dbConnection);
+                    return;
+                }
+
+                bool send_away = away;
+                std::string send_room_id = room_id;
+                auto typing_left = std::chrono::milliseconds::zero();
+                if (!typing_room_id.empty() && typing_room_id == room_id) {
+                    typing_left = std::max(typing_left, TYPING_TTL - std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                            std::chrono::steady_clock::now() - typing_sent_at));
+                }
+                dirty = false;
+                lock.unlock();
+
+                PresenceSnapshot snapshot = exchange(dbConnection, send_away, send_room_id, typing_left,
+                                                     ++heartbeats % CLEAN_UP_EVERY == 0);
+                lock.lock();
+                latest = std::move(snapshot);
+                dispatcher.emit();
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Presence heartbeat failed: " << e.what() << std::endl;
+        }
+
+        // Retry after an interval, unless stopping meanwhile
+        std::unique_lock<std::mutex> lock(mutex);
+        if (wake_up.wait_for(lock, interval, [this]() { return stopping; })) return;
+        dirty = true;
+    }
+}
+
+// Write our heartbeat and read the presence of our rooms back, in one round trip
+PresenceSnapshot PresenceService::exchange(pqxx::connection& dbConnection, bool send_away,
+                                           const std::string& send_room_id, std::chrono::milliseconds typing_left,
+                                           bool clean_up) {
+    PresenceSnapshot snapshot;
+    QueryMetrics::Scope op(db_handler.getMetrics().operation("presence_heartbeat"));
+    try {
+        pqxx::nontransaction txn(dbConnection);
+        pqxx::pipeline pipe(txn);
+
+        std::string typing_until = typing_left.count() > 0
+            ? "NOW() + INTERVAL '" + std::to_string(typing_left.count()) + " milliseconds'" : "NULL";
+        pipe.insert(
+            "INSERT INTO presence (user_id, status, room_id, typing_until, last_seen) "
+            "VALUES (" + txn.quote(user_id) + ", " + txn.quote(send_away ? "away" : "online") + ", "
+            + (send_room_id.empty() ? "NULL" : txn.quote(send_room_id)) + ", " + typing_until + ", NOW()) "
+            "ON CONFLICT (user_id) DO UPDATE SET status = EXCLUDED.status, room_id = EXCLUDED.room_id, "
+            "typing_until = EXCLUDED.typing_until, last_seen = EXCLUDED.last_seen"
+        );
+
+        // Members of our rooms come from the room directory, which the main database always has
+        auto others = pipe.insert(
+            "SELECT others.room_id, p.user_id, p.status, "
+            "COALESCE(p.room_id = others.room_id AND p.typing_until > NOW(), FALSE) AS typing "
+            "FROM room_directory mine "
+            "INNER JOIN room_directory others ON others.room_id = mine.room_id AND others.user_id <> mine.user_id "
+            "INNER JOIN presence p ON p.user_id = others.user_id "
+            "WHERE mine.user_id = " + txn.quote(user_id) + " "
+            "AND p.last_seen > NOW() - INTERVAL '" + std::to_string(ttl.count()) + " milliseconds' "
+            "ORDER BY others.room_id, p.user_id"
+        );
+
+        if (clean_up) {
+            pipe.insert("DELETE FROM presence WHERE last_seen < NOW() - INTERVAL '1 hour'");
+        }
+        pipe.complete();
+
+        pqxx::result result = pipe.retrieve(others);
+        op.rows(result.size());
+        for (const auto& row : result) {
+            RoomPresence& room = snapshot[row["room_id"].as<std::string>()];
+            std::string other_id = row["user_id"].as<std::string>();
+            if (row["typing"].as<bool>()) room.typing_user_ids.push_back(other_id);
+            if (row["status"].as<std::string>() == "away") {
+                room.away_user_ids.push_back(std::move(other_id));
+            } else {
+                room.online_user_ids.push_back(std::move(other_id));
+            }
+        }
+
+    } catch (const std::exception& e) {
+        op.fail();
+        throw std::runtime_error("Failed to exchange presence: " + std::string(e.what()));
+    }
+
+    return snapshot;
+}
+
+// Show up as offline right away instead of after the TTL
+void PresenceService::leave(pqxx::connection& dbConnection) {
+    try {
+        pqxx::nontransaction txn(dbConnection);
+        txn.exec_params("DELETE FROM presence WHERE user_id = $1", user_id);
+    } catch (const std::exception& e) {
+        std::cerr << "Error leaving presence: " << e.what() << std::endl;
+    }
+}
+
+// Views are only updated when something they show changed
+void PresenceService::on_dispatch() {
+    PresenceSnapshot snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        snapshot = latest;
+    }
+    if (snapshot == published) return;
+    published = std::move(snapshot);
+    m_signal_presence_changed.emit(published);
+}
@@ -0,0 +1,232 @@
+#include "query_metrics.h"
+#include "tracer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+// Bucket boundaries exported to Prometheus, in microseconds
+constexpr std::uint64_t EXPORT_BOUNDS_US[] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+    100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+};
+
+constexpr double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+double to_seconds(std::uint64_t micros) {
+    return static_cast<double>(micros) / 1e6;
+}
+
+void write_histogram(std::ostringstream& out, const std::string& name,
+                     const std::string& labels, const LatencyHistogram& histogram) {
+    std::string prefix = labels.empty() ? "" : labels + ",";
+    for (std::uint64_t bound : EXPORT_BOUNDS_US) {
+        out << name << "_bucket{" << prefix << "le=\"" << to_seconds(bound) << "\"} "
+            << histogram.count_at_or_below(bound) << "\n";
+    }
+    out << name << "_bucket{" << prefix << "le=\"+Inf\"} " << histogram.count() << "\n";
+    std::string suffix = labels.empty() ? "" : "{" + labels + "}";
+    out << name << "_sum" << suffix << " " << to_seconds(histogram.sum()) << "\n";
+    out << name << "_count" << suffix << " " << histogram.count() << "\n";
+}
+
+} // namespace
+
+// Histogram
+int LatencyHistogram::bucket_index(std::uint64_t micros) {
+    if (micros < static_cast<std::uint64_t>(SUB_BUCKET_COUNT)) return static_cast<int>(micros);
+    int msb = 63 - __builtin_clzll(micros);
+    int shift = msb - SUB_BUCKET_BITS;
+    int sub = static_cast<int>(micros >> shift) - SUB_BUCKET_COUNT;
+    return SUB_BUCKET_COUNT + shift * SUB_BUCKET_COUNT + sub;
+}
+
+std::uint64_t LatencyHistogram::bucket_upper_bound(int index) {
+    if (index < SUB_BUCKET_COUNT) return static_cast<std::uint64_t>(index);
+    int shift = (index - SUB_BUCKET_COUNT) / SUB_BUCKET_COUNT;
+    std::uint64_t top = SUB_BUCKET_COUNT + (index - SUB_BUCKET_COUNT) % SUB_BUCKET_COUNT;
+    return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::uint64_t micros) {
+    buckets[bucket_index(micros)].fetch_add(1, std::memory_order_relaxed);
+    total_count.fetch_add(1, std::memory_order_relaxed);
+    total_sum.fetch_add(micros, std::memory_order_relaxed);
+
+    std::uint64_t current = max_value.load(std::memory_order_relaxed);
+    while (micros > current &&
+           !max_value.compare_exchange_weak(current, micros, std::memory_order_relaxed)) {
+    }
+}
+
+std::uint64_t LatencyHistogram::percentile(double q) const {
+    std::uint64_t total = count();
+    if (total == 0) return 0;
+
+    // Rank of the wanted value, at least the first one
+    auto rank = static_cast<std::uint64_t>(q * static_cast<double>(total) + 0.5);
+    if (rank == 0) rank = 1;
+
+    std::uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) return std::min(bucket_upper_bound(i), max());
+    }
+    return max();
+}
+
+std::uint64_t LatencyHistogram::count_at_or_below(std::uint64_t micros) const {
+    std::uint64_t total = 0;
+    for (int i = 0; i < BUCKET_COUNT && bucket_upper_bound(i) <= micros; ++i) {
+        total += buckets[i].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+// Scope
+QueryMetrics::Scope::Scope(OperationStats& stats)
+    : stats(stats), start(std::chrono::steady_clock::now()) {
+}
+
+QueryMetrics::Scope::~Scope() {
+    auto end = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+    stats.latency.record(static_cast<std::uint64_t>(elapsed.count()));
+    stats.calls.fetch_add(1, std::memory_order_relaxed);
+    stats.rows.fetch_add(row_count, std::memory_order_relaxed);
+    if (failed) stats.errors.fetch_add(1, std::memory_order_relaxed);
+
+    // Database calls also show up in the UI trace
+    Tracer::instance().record_span(stats.name, "db", start, end);
+}
+
+QueryMetrics::AcquireScope::AcquireScope(QueryMetrics& metrics)
+    : metrics(metrics),
+      start(std::chrono::steady_clock::now()),
+      exceptions_on_entry(std::uncaught_exceptions()) {
+}
+
+QueryMetrics::AcquireScope::~AcquireScope() {
+    bool ok = std::uncaught_exceptions() == exceptions_on_entry;
+    metrics.record_connection_acquire(std::chrono::steady_clock::now() - start, ok);
+}
+
+// Registry
+OperationStats& QueryMetrics::operation(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& stats = operations[name];
+    if (!stats) {
+        stats = std::make_unique<OperationStats>();
+        stats->name = name;
+    }
+    return *stats;
+}
+
+CacheStats& QueryMetrics::cache(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& stats = caches[name];
+    if (!stats) {
+        stats = std::make_unique<CacheStats>();
+        stats->name = name;
+    }
+    return *stats;
+}
+
+void QueryMetrics::record_connection_acquire(std::chrono::steady_clock::duration elapsed, bool ok) {
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    connection_acquire.latency.record(static_cast<std::uint64_t>(micros));
+    connection_acquire.calls.fetch_add(1, std::memory_order_relaxed);
+    if (!ok) connection_acquire.errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string QueryMetrics::to_prometheus() const {
+    std::ostringstream out;
+    out << std::setprecision(9);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    out << "# HELP vaoapp_db_operation_duration_seconds Latency of DatabaseHandler operations.\n";
+    out << "# TYPE vaoapp_db_operation_duration_seconds histogram\n";
+    for (const auto& [name, stats] : operations) {
+        write_histogram(out, "vaoapp_db_operation_duration_seconds",
+                        "operation=\"" + name + "\"", stats->latency);
+    }
+
+    out << "# HELP vaoapp_db_operation_duration_quantile_seconds Latency quantiles of DatabaseHandler operations.\n";
+    out << "# TYPE vaoapp_db_operation_duration_quantile_seconds gauge\n";
+    for (const auto& [name, stats] : operations) {
+        for (double q : QUANTILES) {
+            out << "vaoapp_db_operation_duration_quantile_seconds{operation=\"" << name
+                << "\",quantile=\"" << q << "\"} " << to_seconds(stats->latency.percentile(q)) << "\n";
+        }
+    }
+
+    out << "# HELP vaoapp_db_operation_calls_total Number of calls per operation.\n";
+    out << "# TYPE vaoapp_db_operation_calls_total counter\n";
+    for (const auto& [name, stats] : operations) {
+        out << "vaoapp_db_operation_calls_total{operation=\"" << name << "\"} " << stats->calls.load() << "\n";
+    }
+
+    out << "# HELP vaoapp_db_operation_errors_total Number of failed calls per operation.\n";
+    out << "# TYPE vaoapp_db_operation_errors_total counter\n";
+    for (const auto& [name, stats] : operations) {
+        out << "vaoapp_db_operation_errors_total{operation=\"" << name << "\"} " << stats->errors.load() << "\n";
+    }
+
+    out << "# HELP vaoapp_db_operation_rows_total Number of rows returned per operation.\n";
+    out << "# TYPE vaoapp_db_operation_rows_total counter\n";
+    for (const auto& [name, stats] : operations) {
+        out << "vaoapp_db_operation_rows_total{operation=\"" << name << "\"} " << stats->rows.load() << "\n";
+    }
+
+    out << "# HELP vaoapp_db_operation_coalesced_total Number of calls served by an identical in-flight query.\n";
+    out << "# TYPE vaoapp_db_operation_coalesced_total counter\n";
+    for (const auto& [name, stats] : operations) {
+        out << "vaoapp_db_operation_coalesced_total{operation=\"" << name << "\"} " << stats->coalesced.load() << "\n";
+    }
+
+    out << "# HELP vaoapp_cache_hits_total Number of lookups answered by a client-side cache.\n";
+    out << "# TYPE vaoapp_cache_hits_total counter\n";
+    for (const auto& [name, stats] : caches) {
+        out << "vaoapp_cache_hits_total{cache=\"" << name << "\"} " << stats->hits.load() << "\n";
+    }
+
+    out << "# HELP vaoapp_cache_misses_total Number of lookups a client-side cache sent to the database.\n";
+    out << "# TYPE vaoapp_cache_misses_total counter\n";
+    for (const auto& [name, stats] : caches) {
+        out << "vaoapp_cache_misses_total{cache=\"" << name << "\"} " << stats->misses.load() << "\n";
+    }
+
+    out << "# HELP vaoapp_cache_invalidations_total Number of entries dropped on a change notification.\n";
+    out << "# TYPE vaoapp_cache_invalidations_total counter\n";
+    for (const auto& [name, stats] : caches) {
+        out << "vaoapp_cache_invalidations_total{cache=\"" << name << "\"} " << stats->invalidations.load() << "\n";
+    }
+
+    out << "# HELP vaoapp_db_connection_acquire_seconds Time spent obtaining a database connection.\n";
+    out << "# TYPE vaoapp_db_connection_acquire_seconds histogram\n";
+    write_histogram(out, "vaoapp_db_connection_acquire_seconds", "", connection_acquire.latency);
+
+    out << "# HELP vaoapp_db_connection_errors_total Number of failed connection attempts.\n";
+    out << "# TYPE vaoapp_db_connection_errors_total counter\n";
+    out << "vaoapp_db_connection_errors_total " << connection_acquire.errors.load() << "\n";
+
+    return out.str();
+}
+
+bool QueryMetrics::write_prometheus_file(const std::string& path) const {
+    // Write next to the target then rename, so scrapers never read a partial file
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        if (!file) return false;
+        file << to_prometheus();
+        if (!file) return false;
+    }
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,36 @@
+#include "room_cache.h"
+
+std::optional<RoomInfo> RoomCache::get(const std::string& room_id, const std::string& viewer_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto entry = entries.find(room_id);
+    if (entry == entries.end() || entry->second.viewer_id != viewer_id) {
+        stats.misses.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    stats.hits.fetch_add(1, std::memory_order_relaxed);
+    return entry->second.info;
+}
+
+std::uint64_t RoomCache::current_epoch() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return epoch;
+}
+
+void RoomCache::put(const std::string& room_id, const std::string& viewer_id, RoomInfo info, std::uint64_t read_epoch) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!listening || read_epoch != epoch) return;
+    entries[room_id] = Entry{viewer_id, std::move(info)};
+}
+
+void RoomCache::invalidate(const std::string& room_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++epoch;
+    if (entries.erase(room_id) > 0) stats.invalidations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RoomCache::set_listening(bool new_listening) {
+    std::lock_guard<std::mutex> lock(mutex);
+    listening = new_listening;
+    ++epoch;
+    entries.clear();
+}
@@ -0,0 +1,91 @@
+#include "room_change_listener.h"
+
+namespace {
+
+// Hands every notification of the channel to the listener
+class Receiver : public pqxx::notification_receiver {
+public:
+    Receiver(pqxx::connection& connection, const std::function<void(const std::string&)>& on_notification)
+        : pqxx::notification_receiver(connection, RoomChangeListener::CHANNEL), on_notification(on_notification) {}
+
+    void operator()(const std::string& payload, int) override { on_notification(payload); }
+
+private:
+    std::function<void(const std::string&)> on_notification;
+};
+
+}
+
+RoomChangeListener::RoomChangeListener(DatabaseHandler& db)
+    : db_handler(db), database_count(db.room_database_count()) {
+    dispatcher.connect(sigc::mem_fun(*this, &RoomChangeListener::on_dispatch));
+    for (std::size_t index = 0; index < database_count; ++index) {
+        workers.emplace_back(&RoomChangeListener::run, this, index);
+    }
+}
+
+RoomChangeListener::~RoomChangeListener() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake_up.notify_all();
+    for (auto& worker : workers) worker.join();
+    db_handler.getRoomCache().set_listening(false);
+}
+
+void RoomChangeListener::run(std::size_t database_index) {
+    while (true) {
+        bool listening = false;
+        try {
+            pqxx::connection dbConnection = db_handler.createRoomDatabaseConnection(database_index);
+            Receiver receiver(dbConnection, [this](const std::string& room_id) { on_room_changed(room_id); });
+            listening = true;
+            set_listening(true);
+
+            auto poll_seconds = std::chrono::duration_cast<std::chrono::seconds>(POLL_INTERVAL);
+            auto poll_micros = std::chrono::duration_cast<std::chrono::microseconds>(POLL_INTERVAL - poll_seconds);
+            while (true) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (stopping) return;
+                }
+                dbConnection.await_notification(poll_seconds.count(), poll_micros.count());
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Room change listener failed: " << e.what() << std::endl;
+        }
+
+        // Notifications may be missed until listening again, the cache must not outlive them
+        if (listening) set_listening(false);
+        std::unique_lock<std::mutex> lock(mutex);
+        if (wake_up.wait_for(lock, RETRY_INTERVAL, [this]() { return stopping; })) return;
+    }
+}
+
+// The cache is used only while every database is listened to, and starts over each time
+void RoomChangeListener::set_listening(bool listening) {
+    std::lock_guard<std::mutex> lock(mutex);
+    listening_count = listening ? listening_count + 1 : listening_count - 1;
+    db_handler.getRoomCache().set_listening(listening_count == database_count);
+}
+
+void RoomChangeListener::on_room_changed(const std::string& room_id) {
+    db_handler.getRoomCache().invalidate(room_id);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        changed_room_ids.insert(room_id);
+    }
+    dispatcher.emit();
+}
+
+void RoomChangeListener::on_dispatch() {
+    std::set<std::string> room_ids;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        room_ids.swap(changed_room_ids);
+    }
+    for (const auto& room_id : room_ids) {
+        m_signal_room_changed.emit(room_id);
+    }
+}
@@ -0,0 +1,119 @@
+#include "room_prefetcher.h"
+#include "tracer.h"
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+RoomPrefetcher::RoomPrefetcher(DatabaseHandler& db, const std::string& user_id, std::size_t memory_budget)
+    : db_handler(db), user_id(user_id), memory_budget(memory_budget) {
+    worker = std::thread(&RoomPrefetcher::run, this);
+}
+
+RoomPrefetcher::~RoomPrefetcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake_up.notify_one();
+    worker.join();
+}
+
+void RoomPrefetcher::prefetch_recent(int room_count) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        recent_rooms_requested = std::max(recent_rooms_requested, room_count);
+    }
+    wake_up.notify_one();
+}
+
+void RoomPrefetcher::prefetch(const std::string& room_id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (snapshots.count(room_id)) return;
+        queue.erase(std::remove(queue.begin(), queue.end(), room_id), queue.end());
+        queue.push_front(room_id);
+    }
+    wake_up.notify_one();
+}
+
+std::optional<RoomSnapshot> RoomPrefetcher::take(const std::string& room_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = snapshots.find(room_id);
+    if (found == snapshots.end()) return std::nullopt;
+
+    RoomSnapshot snapshot = std::move(found->second);
+    memory_used -= snapshot.memory_size();
+    snapshots.erase(found);
+    snapshot_lru.remove(room_id);
+    return snapshot;
+}
+
+bool RoomPrefetcher::is_known(const std::string& room_id) const {
+    return snapshots.count(room_id) ||
+           std::find(queue.begin(), queue.end(), room_id) != queue.end();
+}
+
+void RoomPrefetcher::run() {
+    // Lowest scheduling priority for this thread only, the UI comes first
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake_up.wait(lock, [this]() {
+            return stopping || recent_rooms_requested > 0 || !queue.empty();
+        });
+        if (stopping) return;
+
+        if (recent_rooms_requested > 0) {
+            int room_count = recent_rooms_requested;
+            recent_rooms_requested = 0;
+            lock.unlock();
+
+            std::vector<std::string> room_ids;
+            try {
+                room_ids = db_handler.get_most_active_rooms(user_id, room_count);
+            } catch (const std::exception& e) {
+                std::cerr << "Prefetch error: " << e.what() << std::endl;
+            }
+
+            lock.lock();
+            for (const auto& room_id : room_ids) {
+                if (!is_known(room_id)) queue.push_back(room_id);
+            }
+            continue;
+        }
+
+        std::string room_id = queue.front();
+        queue.pop_front();
+        if (snapshots.count(room_id)) continue;
+        lock.unlock();
+
+        try {
+            TraceSpan span("RoomPrefetcher::prefetch", "prefetch");
+            // Prefetched rooms may never be opened, they stay unread
+            store(room_id, db_handler.open_room(room_id, user_id, PAGE_SIZE, false));
+        } catch (const std::exception& e) {
+            std::cerr << "Prefetch error for room " << room_id << ": " << e.what() << std::endl;
+        }
+    }
+}
+
+void RoomPrefetcher::store(const std::string& room_id, RoomSnapshot snapshot) {
+    std::size_t size = snapshot.memory_size();
+    if (size > memory_budget) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stopping || snapshots.count(room_id)) return;
+
+    // Make room by dropping the oldest prefetches
+    while (memory_used + size > memory_budget && !snapshot_lru.empty()) {
+        auto evicted = snapshots.find(snapshot_lru.back());
+        memory_used -= evicted->second.memory_size();
+        snapshots.erase(evicted);
+        snapshot_lru.pop_back();
+    }
+
+    snapshots.emplace(room_id, std::move(snapshot));
+    snapshot_lru.push_front(room_id);
+    memory_used += size;
+}
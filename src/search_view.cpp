@@ -0,0 +1,172 @@
+#include "search_view.h"
+
+#include <ctime>
+
+// Constructor
+SearchView::SearchView(DatabaseHandler& db_handler)
+    : Gtk::Box(),
+      db_handler(db_handler)
+{
+    main_box = Gtk::Box(Gtk::ORIENTATION_VERTICAL, 10);
+    set_halign(Gtk::ALIGN_CENTER); // Center horizontally
+    set_valign(Gtk::ALIGN_CENTER); // Center vertically
+
+    // Setup title
+    title_label.set_text("Search Messages");
+    title_label.get_style_context()->add_class("title-2");
+    title_label.set_halign(Gtk::ALIGN_START);
+
+    // Searches run on Enter, not on every keystroke
+    search_entry.set_placeholder_text("Words to find, \"exact phrase\", -excluded");
+    search_entry.signal_activate().connect(
+        sigc::mem_fun(*this, &SearchView::on_search_activated)
+    );
+
+    // Setup results list
+    results_scroll.set_policy(Gtk::POLICY_NEVER, Gtk::POLICY_AUTOMATIC);
+    results_scroll.add(results_list);
+    results_scroll.set_size_request(500, 450);
+    results_list.set_selection_mode(Gtk::SELECTION_SINGLE);
+    results_list.signal_row_activated().connect(
+        sigc::mem_fun(*this, &SearchView::on_result_activated)
+    );
+
+    status_label.set_halign(Gtk::ALIGN_START);
+
+    // Shown while more results are available
+    more_button.set_label("More results");
+    more_button.set_no_show_all(true);
+    more_button.signal_clicked().connect(
+        sigc::mem_fun(*this, &SearchView::on_more_clicked)
+    );
+
+    go_back_button.set_label("Go Back");
+    go_back_button.set_size_request(-1, 40);
+    go_back_button.signal_clicked().connect(
+        sigc::mem_fun(*this, &SearchView::on_go_back_clicked)
+    );
+
+    // Pack widgets
+    main_box.pack_start(title_label, false, false, 0);
+    main_box.pack_start(search_entry, false, false, 0);
+    main_box.pack_start(status_label, false, false, 0);
+    main_box.pack_start(results_scroll, true, true, 0);
+    main_box.pack_start(more_button, false, false, 0);
+    main_box.pack_start(go_back_button, false, false, 0);
+
+    set_margin_start(20);
+    set_margin_end(20);
+    set_margin_top(20);
+    set_margin_bottom(20);
+
+    add(main_box);
+    show_all();
+    search_entry.grab_focus();
+}
+
+// A new search replaces the results, pages of an older search still in flight are dropped
+void SearchView::on_search_activated() {
+    std::string new_terms = search_entry.get_text();
+    if (new_terms.empty()) return;
+
+    terms = new_terms;
+    ++search_generation;
+    results.clear();
+    for (auto* child : results_list.get_children()) {
+        results_list.remove(*child);
+    }
+    more_button.hide();
+    load_page();
+}
+
+void SearchView::on_more_clicked() {
+    more_button.hide();
+    load_page();
+}
+
+// Fetch the page after the last shown result on the worker, one extra row tells whether more exist
+void SearchView::load_page() {
+    status_label.set_text("Searching...");
+    std::string user_id = db_handler.getCurrentUser().getUserId();
+    std::optional<SearchResult> after;
+    if (!results.empty()) after = results.back();
+
+    auto page = std::make_shared<std::vector<SearchResult>>();
+    auto error = std::make_shared<std::string>();
+    worker.post(
+        [this, user_id, search_terms = terms, after, page, error]() {
+            TraceSpan span("SearchView::search");
+            try {
+                *page = db_handler.search_messages(user_id, search_terms, PAGE_SIZE + 1, after ? &*after : nullptr);
+            } catch (const std::exception& e) {
+                *error = e.what();
+            }
+        },
+        [this, generation = search_generation, page, error]() {
+            show_page(generation, std::move(*page), *error);
+        }
+    );
+}
+
+void SearchView::show_page(unsigned generation, std::vector<SearchResult> page, const std::string& error) {
+    if (generation != search_generation) return;
+    if (!error.empty()) {
+        std::cerr << "Error searching messages: " << error << std::endl;
+        status_label.set_text("Search failed");
+        return;
+    }
+
+    bool has_more = page.size() > static_cast<std::size_t>(PAGE_SIZE);
+    if (has_more) page.pop_back();
+    for (auto& result : page) {
+        append_result_row(result);
+        results.push_back(std::move(result));
+    }
+
+    more_button.set_visible(has_more);
+    if (results.empty()) {
+        status_label.set_text("No messages found");
+    } else {
+        status_label.set_text(std::to_string(results.size()) + (has_more ? "+" : "") + " messages found");
+    }
+}
+
+// Room, sender and date above a short excerpt of the message
+void SearchView::append_result_row(const SearchResult& result) {
+    auto row = Gtk::manage(new Gtk::ListBoxRow());
+    auto box = Gtk::manage(new Gtk::Box(Gtk::ORIENTATION_VERTICAL, 2));
+
+    char date[32];
+    std::time_t time = std::chrono::system_clock::to_time_t(result.timestamp);
+    std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M", std::localtime(&time));
+
+    auto header = Gtk::manage(new Gtk::Label(result.room_name + " - " + result.sender_name + " - " + date));
+    header->set_halign(Gtk::ALIGN_START);
+    header->get_style_context()->add_class("dim-label");
+
+    auto excerpt = Gtk::manage(new Gtk::Label(result.content));
+    excerpt->set_halign(Gtk::ALIGN_START);
+    excerpt->set_ellipsize(Pango::ELLIPSIZE_END);
+    excerpt->set_max_width_chars(60);
+
+    box->pack_start(*header, false, false, 0);
+    box->pack_start(*excerpt, false, false, 0);
+    box->set_margin_top(5);
+    box->set_margin_bottom(5);
+    row->add(*box);
+    row->show_all();
+    results_list.append(*row);
+}
+
+void SearchView::on_result_activated(Gtk::ListBoxRow* row) {
+    if (!row) return;
+    int index = row->get_index();
+    if (index < 0 || static_cast<std::size_t>(index) >= results.size()) return;
+
+    const SearchResult& result = results[index];
+    m_signal_open_search_result.emit(result.room_id, result.room_name, result.message_id);
+}
+
+void SearchView::on_go_back_clicked() {
+    m_signal_back_to_chat_list_requested.emit();
+}
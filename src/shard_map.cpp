@@ -0,0 +1,24 @@
+#include "shard_map.h"
+
+#include <utility>
+
+ShardMap::ShardMap(std::vector<std::string> shard_conn_strs)
+    : shard_conn_strs(std::move(shard_conn_strs)) {
+}
+
+std::size_t ShardMap::shard_for(const std::string& room_id) const {
+    return static_cast<std::size_t>(hash(room_id) % shard_conn_strs.size());
+}
+
+const std::string& ShardMap::connection_string_for(const std::string& room_id) const {
+    return shard_conn_strs[shard_for(room_id)];
+}
+
+std::uint64_t ShardMap::hash(const std::string& key) {
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
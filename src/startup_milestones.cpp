@@ -0,0 +1,77 @@
+#include "startup_milestones.h"
+#include "tracer.h"
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+// /proc/self/stat gives the start time in clock ticks since boot (10 ms resolution),
+// compared with the time since boot now. Falls back to now when unavailable.
+StartupMilestones::Clock::time_point StartupMilestones::process_start_time() {
+    Clock::time_point now = Clock::now();
+    std::ifstream stat("/proc/self/stat");
+    std::string line;
+    timespec since_boot{};
+    if (!std::getline(stat, line) || clock_gettime(CLOCK_BOOTTIME, &since_boot) != 0) return now;
+
+    // Fields after the command name, which may hold spaces: starttime is the 20th
+    std::istringstream fields(line.substr(line.rfind(')') + 2));
+    std::string field;
+    for (int i = 0; i < 20 && fields >> field; ++i) {}
+    long ticks_per_second = sysconf(_SC_CLK_TCK);
+    if (!fields || ticks_per_second <= 0) return now;
+
+    double started = std::stod(field) / ticks_per_second;
+    double elapsed = since_boot.tv_sec + since_boot.tv_nsec / 1e9 - started;
+    if (elapsed < 0 || elapsed > 60) return now;
+    return now - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(elapsed));
+}
+
+StartupMilestones::StartupMilestones(Clock::time_point process_start) : process_start(process_start) {
+}
+
+StartupMilestones::~StartupMilestones() {
+    if (after_paint_id) g_signal_handler_disconnect(frame_clock, after_paint_id);
+}
+
+void StartupMilestones::watch(Gtk::Window& window) {
+    frame_clock = gtk_widget_get_frame_clock(GTK_WIDGET(window.gobj()));
+    if (!frame_clock) {
+        std::cerr << "Startup milestones: the window has no frame clock yet" << std::endl;
+        return;
+    }
+    after_paint_id = g_signal_connect(frame_clock, "after-paint", G_CALLBACK(on_after_paint), this);
+}
+
+void StartupMilestones::on_after_paint(GdkFrameClock* clock, gpointer data) {
+    auto milestones = static_cast<StartupMilestones*>(data);
+    g_signal_handler_disconnect(clock, milestones->after_paint_id);
+    milestones->after_paint_id = 0;
+    milestones->on_first_frame();
+}
+
+void StartupMilestones::on_first_frame() {
+    first_frame = Clock::now();
+    Tracer::instance().record_span("startup-first-frame", "startup", process_start, *first_frame);
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(*first_frame - process_start);
+    if (elapsed > FIRST_FRAME_TARGET) {
+        std::cerr << "First frame shown " << elapsed.count() << " ms after start (target "
+                  << FIRST_FRAME_TARGET.count() << " ms)" << std::endl;
+    }
+    record_login_ready();
+}
+
+void StartupMilestones::database_ready() {
+    database_warmed_up = true;
+    record_login_ready();
+}
+
+// Whichever of the first frame and the warm-up ends last
+void StartupMilestones::record_login_ready() {
+    if (!first_frame || !database_warmed_up || login_ready_recorded) return;
+    login_ready_recorded = true;
+    Tracer::instance().record_span("startup-login-ready", "startup", process_start, Clock::now());
+}
@@ -0,0 +1,127 @@
+#include "text_search.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void fold_ascii_case(std::string_view text, std::string& out) {
+    std::size_t start = out.size();
+    out.resize(start + text.size());
+    char* dest = &out[start];
+    std::size_t i = 0;
+
+#if defined(__SSE2__)
+    // Signed compares: bytes >= 0x80 are negative, so never taken for 'A'..'Z'
+    const __m128i before_a = _mm_set1_epi8('A' - 1);
+    const __m128i after_z = _mm_set1_epi8('Z' + 1);
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    for (; i + 16 <= text.size(); i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i));
+        __m128i is_upper = _mm_and_si128(_mm_cmpgt_epi8(block, before_a), _mm_cmplt_epi8(block, after_z));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_or_si128(block, _mm_and_si128(is_upper, case_bit)));
+    }
+#endif
+
+    for (; i < text.size(); ++i) {
+        char c = text[i];
+        dest[i] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+}
+
+std::size_t find_bytes(std::string_view haystack, std::string_view needle, std::size_t from) {
+    const std::size_t length = needle.size();
+    if (length == 0) return from <= haystack.size() ? from : std::string_view::npos;
+    if (haystack.size() < length || from > haystack.size() - length) return std::string_view::npos;
+
+    const char* data = haystack.data();
+    const std::size_t last_start = haystack.size() - length;
+    std::size_t i = from;
+
+#if defined(__SSE2__)
+    // Candidates have both the first and the last needle byte in place, only those are compared
+    const __m128i first = _mm_set1_epi8(needle.front());
+    const __m128i last = _mm_set1_epi8(needle.back());
+    for (; i + 15 <= last_start; i += 16) {
+        __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + length - 1));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last))));
+        while (mask != 0) {
+            unsigned offset = static_cast<unsigned>(__builtin_ctz(mask));
+            if (length <= 2 || std::memcmp(data + i + offset + 1, needle.data() + 1, length - 2) == 0) {
+                return i + offset;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    while (i <= last_start) {
+        const void* hit = std::memchr(data + i, needle.front(), last_start - i + 1);
+        if (!hit) break;
+        i = static_cast<const char*>(hit) - data;
+        if (std::memcmp(data + i, needle.data(), length) == 0) return i;
+        ++i;
+    }
+    return std::string_view::npos;
+}
+
+void FindIndex::add(Side& side, std::string_view content) {
+    side.starts.push_back(side.folded.size());
+    fold_ascii_case(content, side.folded);
+    side.folded.push_back('\0');
+}
+
+// Search the entries added since the last scan, one match per entry is enough
+void FindIndex::scan(Side& side) {
+    if (side.scanned == side.starts.size()) return;
+
+    std::string_view buffer(side.folded);
+    std::size_t position = side.starts[side.scanned];
+    while ((position = find_bytes(buffer, query, position)) != std::string_view::npos) {
+        std::size_t entry = std::upper_bound(side.starts.begin() + side.scanned, side.starts.end(), position)
+                          - side.starts.begin() - 1;
+        side.matches.push_back(entry);
+        if (entry + 1 == side.starts.size()) break;
+        position = side.starts[entry + 1];
+    }
+    side.scanned = side.starts.size();
+}
+
+std::vector<std::size_t> FindIndex::find(std::string_view text) {
+    std::string folded_text;
+    fold_ascii_case(text, folded_text);
+    if (folded_text != query) {
+        query = std::move(folded_text);
+        for (Side* side : {&older, &newer}) {
+            side->scanned = 0;
+            side->matches.clear();
+        }
+    }
+
+    std::vector<std::size_t> indexes;
+    if (query.empty()) return indexes;
+    scan(older);
+    scan(newer);
+
+    // The older side is numbered from the most recently prepended message, the oldest one last
+    indexes.reserve(older.matches.size() + newer.matches.size());
+    for (auto entry = older.matches.rbegin(); entry != older.matches.rend(); ++entry) {
+        indexes.push_back(older.starts.size() - 1 - *entry);
+    }
+    for (std::size_t entry : newer.matches) {
+        indexes.push_back(older.starts.size() + entry);
+    }
+    return indexes;
+}
+
+std::size_t FindIndex::memory_size() const {
+    std::size_t size = sizeof(FindIndex) + query.capacity();
+    for (const Side* side : {&older, &newer}) {
+        size += side->folded.capacity() + (side->starts.capacity() + side->matches.capacity()) * sizeof(std::size_t);
+    }
+    return size;
+}
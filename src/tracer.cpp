@@ -0,0 +1,109 @@
+#include "tracer.h"
+
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+// Minimal JSON string escaping for event names
+std::string escape_json(const std::string& text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) >= 0x20) escaped += c;
+        }
+    }
+    return escaped;
+}
+
+} // namespace
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::Tracer() : origin(clock::now()) {
+}
+
+void Tracer::enable(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    output_path = path;
+    enabled.store(true, std::memory_order_relaxed);
+}
+
+std::uint32_t Tracer::current_thread_id() {
+    static std::atomic<std::uint32_t> next_id{1};
+    thread_local std::uint32_t id = next_id.fetch_add(1);
+    return id;
+}
+
+void Tracer::push(Event event) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (events.size() >= MAX_EVENTS) {
+        ++dropped_events;
+        return;
+    }
+    events.push_back(std::move(event));
+}
+
+void Tracer::record_span(const std::string& name, const char* category,
+                         clock::time_point start, clock::time_point end) {
+    if (!is_enabled()) return;
+    auto since_origin = std::chrono::duration_cast<std::chrono::microseconds>(start - origin);
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+    push({name, category, 'X', since_origin.count(), duration.count(), current_thread_id()});
+}
+
+void Tracer::record_instant(const std::string& name, const char* category) {
+    if (!is_enabled()) return;
+    auto since_origin = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - origin);
+    push({name, category, 'i', since_origin.count(), 0, current_thread_id()});
+}
+
+bool Tracer::flush() {
+    if (!is_enabled()) return true;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ofstream file(output_path, std::ios::trunc);
+    if (!file) {
+        std::cerr << "Could not write trace to " << output_path << std::endl;
+        return false;
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        const Event& event = events[i];
+        file << "{\"name\":\"" << escape_json(event.name) << "\",\"cat\":\"" << event.category
+             << "\",\"ph\":\"" << event.phase << "\",\"ts\":" << event.timestamp_us
+             << ",\"pid\":1,\"tid\":" << event.thread_id;
+        if (event.phase == 'X') file << ",\"dur\":" << event.duration_us;
+        if (event.phase == 'i') file << ",\"s\":\"t\"";
+        file << "}" << (i + 1 < events.size() ? ",\n" : "\n");
+    }
+    file << "]}\n";
+
+    if (dropped_events > 0) {
+        std::cerr << "Trace buffer full, " << dropped_events << " events dropped" << std::endl;
+    }
+    return static_cast<bool>(file);
+}
+
+// Span
+TraceSpan::TraceSpan(std::string name, const char* category)
+    : category(category), active(Tracer::instance().is_enabled()) {
+    if (active) {
+        this->name = std::move(name);
+        start = Tracer::clock::now();
+    }
+}
+
+TraceSpan::~TraceSpan() {
+    if (active) Tracer::instance().record_span(name, category, start, Tracer::clock::now());
+}
@@ -0,0 +1,89 @@
+// Message retention, run by the operator (by hand or from cron), never by the app. Detaches
+// the monthly messages partitions older than --keep-months full months on every database
+// holding messages, and removes the attachments of their messages along with the contents
+// no other message uses. Detached months are kept as plain messages_YYYY_MM tables, or
+// dropped with --drop.
+//
+//   vaoapp_archive_messages --keep-months=12
+//   vaoapp_archive_messages --keep-months=12 --drop
+//
+// The databases come from VAOAPP_ARCHIVE_DB: the main database, or each shard when rooms
+// are sharded, separated by ';'. archive_message_partitions is not granted to vaoapp_user,
+// so these connect as the owner of the schema.
+
+#include <pqxx/pqxx>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Options {
+    std::vector<std::string> conn_strs{"host=localhost port=5432 dbname=vaodb user=postgres password=admin_password"};
+    int keep_months = 0;
+    bool drop = false;
+};
+
+static bool parse_options(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&arg](const char* flag) -> const char* {
+            std::size_t length = std::strlen(flag);
+            return arg.compare(0, length, flag) == 0 ? arg.c_str() + length : nullptr;
+        };
+        if (arg == "--drop") options.drop = true;
+        else if (auto v = value("--keep-months=")) options.keep_months = std::atoi(v);
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    // Keeping no month at all would detach the current one
+    return options.keep_months > 0;
+}
+
+static std::vector<std::string> connection_strings_from_env(const char* name) {
+    std::vector<std::string> conn_strs;
+    const char* setting = std::getenv(name);
+    if (!setting) return conn_strs;
+
+    std::stringstream entries(setting);
+    std::string entry;
+    while (std::getline(entries, entry, ';')) {
+        if (!entry.empty()) conn_strs.push_back(entry);
+    }
+    return conn_strs;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " --keep-months=N [--drop]" << std::endl;
+        return 2;
+    }
+    auto conn_strs = connection_strings_from_env("VAOAPP_ARCHIVE_DB");
+    if (!conn_strs.empty()) options.conn_strs = conn_strs;
+
+    // Each database is archived in a transaction of its own, a failure leaves the others done
+    int failed = 0;
+    for (std::size_t index = 0; index < options.conn_strs.size(); ++index) {
+        try {
+            pqxx::connection connection(options.conn_strs[index]);
+            pqxx::work txn(connection);
+            pqxx::result archived = txn.exec_params(
+                "SELECT archive_message_partitions($1, $2);", options.keep_months, options.drop
+            );
+            txn.commit();
+
+            for (const auto& row : archived) {
+                std::cout << "Database " << index << ": " << (options.drop ? "dropped " : "archived ")
+                          << row[0].as<std::string>() << std::endl;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to archive messages of database " << index << ": " << e.what() << std::endl;
+            ++failed;
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
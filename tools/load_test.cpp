@@ -0,0 +1,493 @@
+// Headless load generator for the data layer. Simulated users log in, list their rooms,
+// open rooms, send messages, search and browse members, all through one DatabaseHandler
+// shared by a pool of worker threads, like the app's views and background workers do.
+//
+// Sessions arrive at a fixed rate (Poisson arrivals) whatever the database keeps up with,
+// and each action is timed from when it was due, so a saturated database shows up as
+// growing latencies instead of fewer requests (no coordinated omission).
+//
+//   vaoapp_load_test --setup --users=2000
+//   vaoapp_load_test --rate=50 --duration=60
+//   vaoapp_load_test --rate=10 --saturate --p99-limit-ms=250
+//
+// The database comes from VAOAPP_DB, VAOAPP_DB_REPLICAS and VAOAPP_DB_SHARDS, as for the app.
+
+#include "database_handler.h"
+#include "query_metrics.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+enum Operation { LOGIN, LIST_ROOMS, OPEN_ROOM, SEND_MESSAGE, SEARCH, MEMBERS, OPERATION_COUNT };
+static const char* const OPERATION_NAMES[OPERATION_COUNT] = {
+    "login", "list_rooms", "open_room", "send_message", "search", "members"
+};
+
+// Words of the seeded messages, searched for by the simulated users
+static const char* const WORDS[] = {
+    "meeting", "deploy", "lunch", "review", "release", "budget", "design", "incident"
+};
+
+static const char* const PASSWORD = "loadtest";
+
+struct Options {
+    std::string conn_str = "host=localhost port=5432 dbname=vaodb user=vaoapp_user password=vaoapp_user_password";
+    int users = 1000;               // accounts the sessions are drawn from
+    int threads = 64;               // worker threads, shared by all the simulated users
+    double rate = 20;               // sessions started per second
+    int actions = 10;               // actions per session after logging in
+    int think_ms = 2000;            // mean think time between two actions (exponential)
+    int duration_s = 30;            // length of a stage
+    std::array<double, OPERATION_COUNT> mix{{0, 1, 4, 2, 1, 0.5}};  // weights, login is always first
+
+    // --setup creates the accounts, their rooms and a few messages per room
+    bool setup = false;
+    int room_size = 8;
+    int rooms_per_user = 4;
+    int seed_messages = 10;
+
+    // --saturate multiplies the rate by step after each stage until a limit is crossed
+    bool saturate = false;
+    double step = 1.5;
+    int max_stages = 12;
+    double p99_limit_ms = 500;
+    double max_error_rate = 0.01;
+
+    std::string metrics_path;       // DatabaseHandler metrics written at the end, when given
+};
+
+struct Account {
+    std::string user_id;
+    std::string username;
+};
+
+// Counters of one stage, every histogram in microseconds
+struct StageStats {
+    std::array<LatencyHistogram, OPERATION_COUNT> response;   // from when the action was due
+    std::array<LatencyHistogram, OPERATION_COUNT> service;    // from when the call started
+    std::array<std::atomic<std::uint64_t>, OPERATION_COUNT> errors{};
+    LatencyHistogram lag;                                      // due to picked up by a worker
+    std::atomic<std::uint64_t> sessions{0};
+    std::uint64_t timed_out = 0;                               // due but unserved at the stage end
+};
+
+struct Session {
+    const Account* account;
+    std::string user_id;            // set once logged in
+    std::vector<std::string> room_ids;
+    bool rooms_listed = false;
+    int actions_left;
+    std::mt19937_64 rng;
+};
+
+// Sessions waiting for their next action, earliest due first
+class Scheduler {
+private:
+    struct Task {
+        Clock::time_point due;
+        std::shared_ptr<Session> session;
+        bool operator>(const Task& other) const { return due > other.due; }
+    };
+
+    std::mutex mutex;
+    std::condition_variable wake_up;
+    std::priority_queue<Task, std::vector<Task>, std::greater<Task>> tasks;
+    bool stopping = false;
+
+public:
+    void push(Clock::time_point due, std::shared_ptr<Session> session) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push(Task{due, std::move(session)});
+        }
+        wake_up.notify_one();
+    }
+
+    // Blocks until a session is due, false once stopped
+    bool pop(Clock::time_point& due, std::shared_ptr<Session>& session) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            if (tasks.empty()) {
+                wake_up.wait(lock);
+            } else if (tasks.top().due > Clock::now()) {
+                wake_up.wait_until(lock, tasks.top().due);
+            } else {
+                due = tasks.top().due;
+                session = tasks.top().session;
+                tasks.pop();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Stops the workers, returns the actions that were due by then and not picked up
+    std::vector<std::pair<Clock::time_point, std::shared_ptr<Session>>> stop(Clock::time_point now) {
+        std::vector<std::pair<Clock::time_point, std::shared_ptr<Session>>> unserved;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            while (!tasks.empty() && tasks.top().due <= now) {
+                unserved.emplace_back(tasks.top().due, tasks.top().session);
+                tasks.pop();
+            }
+        }
+        wake_up.notify_all();
+        return unserved;
+    }
+};
+
+static std::uint64_t micros_since(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+static Operation pick_operation(const Options& options, Session& session) {
+    if (session.user_id.empty()) return LOGIN;
+    if (!session.rooms_listed) return LIST_ROOMS;
+    std::discrete_distribution<int> mix(options.mix.begin() + 1, options.mix.end());
+    Operation operation = static_cast<Operation>(mix(session.rng) + 1);
+    // Nothing to open in a session without rooms
+    if (session.room_ids.empty() && (operation == OPEN_ROOM || operation == SEND_MESSAGE || operation == MEMBERS)) {
+        return LIST_ROOMS;
+    }
+    return operation;
+}
+
+// Run the next action of a session, timed from when it was due
+static void run_action(DatabaseHandler& db_handler, const Options& options, Session& session,
+                       StageStats& stats, Clock::time_point due) {
+    Operation operation = pick_operation(options, session);
+    const std::string* room_id = nullptr;
+    if (!session.room_ids.empty()) {
+        room_id = &session.room_ids[std::uniform_int_distribution<std::size_t>(0, session.room_ids.size() - 1)(session.rng)];
+    }
+
+    auto start = Clock::now();
+    bool failed = false;
+    try {
+        switch (operation) {
+        case LOGIN: {
+            auto user = db_handler.verifyUserCredentials(session.account->username, DatabaseHandler::hashPassword(PASSWORD));
+            if (user) session.user_id = user->getUserId();
+            else failed = true;
+            break;
+        }
+        case LIST_ROOMS:
+            session.room_ids.clear();
+            for (const auto& conversation : db_handler.load_user_conversations(session.user_id)) {
+                session.room_ids.push_back(conversation.first);
+            }
+            session.rooms_listed = true;
+            break;
+        case OPEN_ROOM:
+            db_handler.open_room(*room_id, session.user_id, 50, true);
+            break;
+        case SEND_MESSAGE:
+            db_handler.send_message(*room_id, session.user_id,
+                                    std::string("load test ") + WORDS[session.rng() % std::size(WORDS)]);
+            break;
+        case SEARCH:
+            db_handler.search_messages(session.user_id, WORDS[session.rng() % std::size(WORDS)], 30);
+            break;
+        case MEMBERS:
+            db_handler.get_room_members_page(*room_id, session.user_id, "", 100);
+            break;
+        default:
+            break;
+        }
+    } catch (const std::exception&) {
+        failed = true;
+    }
+
+    stats.service[operation].record(micros_since(start));
+    stats.response[operation].record(micros_since(due));
+    if (failed) stats.errors[operation].fetch_add(1, std::memory_order_relaxed);
+}
+
+// One stage at a fixed arrival rate, sessions still running at the end are dropped and
+// their actions already due are counted as timed out
+static std::unique_ptr<StageStats> run_stage(DatabaseHandler& db_handler, const Options& options,
+                                             const std::vector<Account>& accounts, double rate) {
+    auto stats = std::make_unique<StageStats>();
+    Scheduler scheduler;
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.threads; ++i) {
+        workers.emplace_back([&, seed = static_cast<unsigned>(i)]() {
+            std::mt19937_64 rng(seed);
+            std::exponential_distribution<double> think(1.0 / std::max(options.think_ms, 1));
+            Clock::time_point due;
+            std::shared_ptr<Session> session;
+            while (scheduler.pop(due, session)) {
+                stats->lag.record(micros_since(due));
+                run_action(db_handler, options, *session, *stats, due);
+                if (--session->actions_left >= 0) {
+                    scheduler.push(Clock::now() + std::chrono::milliseconds(static_cast<long>(think(rng))), session);
+                }
+            }
+        });
+    }
+
+    // Arrivals are scheduled ahead on the clock, not after the previous one was served
+    std::mt19937_64 rng(42);
+    std::exponential_distribution<double> interarrival(rate);
+    auto stage_end = Clock::now() + std::chrono::seconds(options.duration_s);
+    auto next_arrival = Clock::now();
+    while (next_arrival < stage_end) {
+        auto session = std::make_shared<Session>();
+        session->account = &accounts[rng() % accounts.size()];
+        session->actions_left = options.actions;
+        session->rng.seed(rng());
+        scheduler.push(next_arrival, session);
+        stats->sessions.fetch_add(1, std::memory_order_relaxed);
+
+        next_arrival += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interarrival(rng)));
+        std::this_thread::sleep_until(std::min(next_arrival, stage_end));
+    }
+
+    // Actions still waiting for a worker count as timed out, waiting until the stage end
+    auto stopped = Clock::now();
+    auto unserved = scheduler.stop(stopped);
+    for (auto& worker : workers) worker.join();
+    for (auto& [due, session] : unserved) {
+        Operation operation = pick_operation(options, *session);
+        stats->response[operation].record(
+            std::chrono::duration_cast<std::chrono::microseconds>(stopped - due).count());
+        stats->errors[operation].fetch_add(1, std::memory_order_relaxed);
+    }
+    stats->timed_out = unserved.size();
+    return stats;
+}
+
+static double to_ms(std::uint64_t micros) {
+    return micros / 1000.0;
+}
+
+// Throughput, latency quantiles and error rate per operation. Returns whether the stage
+// stayed within the limits (p99 response and error rate of every operation).
+static bool report_stage(const StageStats& stats, const Options& options, double rate) {
+    std::printf("\n== %.1f sessions/s, %llu sessions in %d s, worker lag p99 %.1f ms, %llu due actions timed out ==\n",
+                rate, static_cast<unsigned long long>(stats.sessions.load()), options.duration_s,
+                to_ms(stats.lag.percentile(0.99)), static_cast<unsigned long long>(stats.timed_out));
+    std::printf("%-14s %10s %8s %10s %10s %10s %10s %8s\n",
+                "operation", "calls", "ops/s", "p50 ms", "p99 ms", "p999 ms", "svc p99", "errors");
+
+    bool within_limits = true;
+    std::uint64_t total_calls = 0;
+    for (int op = 0; op < OPERATION_COUNT; ++op) {
+        const auto& response = stats.response[op];
+        std::uint64_t calls = response.count();
+        if (calls == 0) continue;
+        total_calls += calls;
+        double error_rate = static_cast<double>(stats.errors[op].load()) / calls;
+        double p99 = to_ms(response.percentile(0.99));
+        std::printf("%-14s %10llu %8.1f %10.1f %10.1f %10.1f %10.1f %7.2f%%\n",
+                    OPERATION_NAMES[op], static_cast<unsigned long long>(calls),
+                    static_cast<double>(calls) / options.duration_s,
+                    to_ms(response.percentile(0.5)), p99, to_ms(response.percentile(0.999)),
+                    to_ms(stats.service[op].percentile(0.99)), error_rate * 100);
+        if (p99 > options.p99_limit_ms || error_rate > options.max_error_rate) within_limits = false;
+    }
+    std::printf("%-14s %10llu %8.1f\n", "total", static_cast<unsigned long long>(total_calls),
+                static_cast<double>(total_calls) / options.duration_s);
+    return within_limits;
+}
+
+static std::vector<Account> load_accounts(DatabaseHandler& db_handler, int limit) {
+    std::vector<Account> accounts;
+    PooledConnection dbConnection = db_handler.createConnection();
+    pqxx::work txn(dbConnection);
+    pqxx::result result = txn.exec_params(
+        "SELECT user_id, username FROM users WHERE username LIKE 'loadtest\\_%' ORDER BY username LIMIT $1;", limit
+    );
+    for (const auto& row : result) {
+        accounts.push_back(Account{row[0].as<std::string>(), row[1].as<std::string>()});
+    }
+    return accounts;
+}
+
+// Accounts loadtest_000001..., in rooms of room_size consecutive accounts, each account
+// in about rooms_per_user of them, every room with a few messages
+static void setup_data(DatabaseHandler& db_handler, const Options& options) {
+    std::string password_hash = DatabaseHandler::hashPassword(PASSWORD);
+    std::vector<std::string> user_ids;
+    std::vector<std::string> usernames;
+    for (int i = 1; i <= options.users; ++i) {
+        char username[32];
+        std::snprintf(username, sizeof(username), "loadtest_%06d", i);
+        User user(username, password_hash);
+        user_ids.push_back(user.getUserId());
+        usernames.push_back(username);
+    }
+
+    auto to_array = [](const std::vector<std::string>& values) {
+        std::string array_str = "{";
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            if (i > 0) array_str += ",";
+            array_str += "\"" + values[i] + "\"";
+        }
+        return array_str + "}";
+    };
+
+    {
+        PooledConnection dbConnection = db_handler.createConnection();
+        pqxx::work txn(dbConnection);
+        txn.exec_params(
+            "INSERT INTO users (user_id, username, password_hash) "
+            "SELECT user_id, username, $3 FROM unnest($1::text[], $2::text[]) AS new_users (user_id, username) "
+            "ON CONFLICT (username) DO NOTHING;",
+            to_array(user_ids), to_array(usernames), password_hash
+        );
+        txn.commit();
+    }
+
+    std::vector<Account> accounts = load_accounts(db_handler, options.users);
+    if (accounts.empty()) return;
+
+    std::size_t room_size = std::min<std::size_t>(std::max(options.room_size, 2), accounts.size());
+    std::size_t room_count = std::max<std::size_t>(1, accounts.size() * options.rooms_per_user / room_size);
+    for (std::size_t room = 0; room < room_count; ++room) {
+        std::size_t first = room * accounts.size() / room_count;
+        std::vector<std::string> member_ids;
+        for (std::size_t i = 0; i < room_size; ++i) {
+            member_ids.push_back(accounts[(first + i) % accounts.size()].user_id);
+        }
+        std::string room_id = db_handler.get_or_create_chat_room(member_ids, "Load test " + std::to_string(room + 1));
+        for (int i = 0; i < options.seed_messages; ++i) {
+            db_handler.send_message(room_id, member_ids[i % member_ids.size()],
+                                    std::string("seeded ") + WORDS[i % std::size(WORDS)] + " message " + std::to_string(i));
+        }
+        if ((room + 1) % 100 == 0) std::cout << "Set up " << room + 1 << "/" << room_count << " rooms" << std::endl;
+    }
+    std::cout << "Set up " << accounts.size() << " accounts in " << room_count << " rooms" << std::endl;
+}
+
+// --mix=list_rooms:1,open_room:4,send_message:2,search:1,members:0.5
+static bool parse_mix(const std::string& setting, std::array<double, OPERATION_COUNT>& mix) {
+    std::array<double, OPERATION_COUNT> parsed{};
+    std::stringstream entries(setting);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        auto separator = entry.find(':');
+        if (separator == std::string::npos) return false;
+        std::string name = entry.substr(0, separator);
+        int op = 0;
+        while (op < OPERATION_COUNT && name != OPERATION_NAMES[op]) ++op;
+        if (op == OPERATION_COUNT || op == LOGIN) return false;
+        parsed[op] = std::atof(entry.c_str() + separator + 1);
+    }
+    mix = parsed;
+    return true;
+}
+
+static std::vector<std::string> connection_strings_from_env(const char* name) {
+    std::vector<std::string> conn_strs;
+    const char* setting = std::getenv(name);
+    if (!setting) return conn_strs;
+
+    std::stringstream entries(setting);
+    std::string entry;
+    while (std::getline(entries, entry, ';')) {
+        if (!entry.empty()) conn_strs.push_back(entry);
+    }
+    return conn_strs;
+}
+
+static bool parse_options(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&arg](const char* flag) -> const char* {
+            std::size_t length = std::strlen(flag);
+            return arg.compare(0, length, flag) == 0 ? arg.c_str() + length : nullptr;
+        };
+        if (arg == "--setup") options.setup = true;
+        else if (arg == "--saturate") options.saturate = true;
+        else if (auto v = value("--users=")) options.users = std::atoi(v);
+        else if (auto v = value("--threads=")) options.threads = std::atoi(v);
+        else if (auto v = value("--rate=")) options.rate = std::atof(v);
+        else if (auto v = value("--actions=")) options.actions = std::atoi(v);
+        else if (auto v = value("--think-ms=")) options.think_ms = std::atoi(v);
+        else if (auto v = value("--duration=")) options.duration_s = std::atoi(v);
+        else if (auto v = value("--room-size=")) options.room_size = std::atoi(v);
+        else if (auto v = value("--rooms-per-user=")) options.rooms_per_user = std::atoi(v);
+        else if (auto v = value("--seed-messages=")) options.seed_messages = std::atoi(v);
+        else if (auto v = value("--step=")) options.step = std::atof(v);
+        else if (auto v = value("--max-stages=")) options.max_stages = std::atoi(v);
+        else if (auto v = value("--p99-limit-ms=")) options.p99_limit_ms = std::atof(v);
+        else if (auto v = value("--max-error-rate=")) options.max_error_rate = std::atof(v);
+        else if (auto v = value("--metrics=")) options.metrics_path = v;
+        else if (auto v = value("--mix=")) {
+            if (!parse_mix(v, options.mix)) {
+                std::cerr << "Invalid mix: " << v << std::endl;
+                return false;
+            }
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return options.users > 0 && options.threads > 0 && options.rate > 0 && options.duration_s > 0;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--setup] [--users=N] [--threads=N] [--rate=sessions/s] [--actions=N]"
+                     " [--think-ms=N] [--duration=s] [--mix=op:weight,...] [--saturate] [--step=x]"
+                     " [--max-stages=N] [--p99-limit-ms=N] [--max-error-rate=x] [--metrics=file]" << std::endl;
+        return 2;
+    }
+    if (std::getenv("VAOAPP_DB")) options.conn_str = std::getenv("VAOAPP_DB");
+
+    DatabaseHandler db_handler(options.conn_str, connection_strings_from_env("VAOAPP_DB_REPLICAS"),
+                               connection_strings_from_env("VAOAPP_DB_SHARDS"));
+    try {
+        if (options.setup) setup_data(db_handler, options);
+        std::vector<Account> accounts = load_accounts(db_handler, options.users);
+        if (accounts.empty()) {
+            std::cerr << "No load test accounts, run with --setup first" << std::endl;
+            return 1;
+        }
+
+        // A single stage, or growing rates until latency or errors cross the limits
+        double rate = options.rate;
+        double last_within_limits = 0;
+        int stages = options.saturate ? options.max_stages : 1;
+        for (int stage = 0; stage < stages; ++stage) {
+            auto stats = run_stage(db_handler, options, accounts, rate);
+            bool within_limits = report_stage(*stats, options, rate);
+            if (!options.saturate) break;
+            if (!within_limits) {
+                std::printf("\nSaturated at %.1f sessions/s, last rate within limits: %.1f sessions/s\n",
+                            rate, last_within_limits);
+                break;
+            }
+            last_within_limits = rate;
+            rate *= options.step;
+        }
+
+        if (!options.metrics_path.empty() && !db_handler.getMetrics().write_prometheus_file(options.metrics_path)) {
+            std::cerr << "Could not write metrics to " << options.metrics_path << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Load test failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
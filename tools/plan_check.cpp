@@ -0,0 +1,575 @@
+// Query plan regression check of the statements the data layer issues (include/queries.h),
+// against a large deterministic dataset. Each statement runs under EXPLAIN (ANALYZE, BUFFERS)
+// with sample arguments, and fails when:
+//   - a table larger than --seq-scan-rows is read by a sequential scan
+//   - an index the statement is expected to use does not show up in its plan
+//   - it touches more shared buffers, or runs longer, than its ceiling
+//   - its plan differs from the snapshot in tools/plans (the plans then show up in review),
+//     or it has no snapshot yet
+//
+//   vaoapp_plan_check --setup               seeds the dataset once, then checks
+//   vaoapp_plan_check                       checks every statement
+//   vaoapp_plan_check --update-snapshots    accepts the current plans, also the first ones
+//
+// The database comes from VAOAPP_PLAN_DB. It has to be a disposable one set up by init.sql,
+// --setup writes a million messages to it and needs a superuser (triggers and foreign key
+// checks are skipped while seeding). Writes are checked in transactions rolled back afterwards.
+//
+// Ceilings are set for the default scale with some headroom, a change making a statement
+// heavier on purpose updates its ceiling in the same commit.
+
+#include "queries.h"
+#include <pqxx/pqxx>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef PLAN_SNAPSHOT_DIR
+#define PLAN_SNAPSHOT_DIR "tools/plans"
+#endif
+
+// Seeded months, in partitions of their own like the app's
+static const char* const SEED_START = "2025-01-01";
+static const int SEED_MONTHS = 12;
+
+static const char* const SEARCH_TERMS = "deploy review";
+
+struct Options {
+    std::string conn_str = "host=localhost port=5432 dbname=vaodb user=postgres password=admin_password";
+    bool setup = false;
+    bool update_snapshots = false;
+    std::string only;               // checks whose name contains it, all when empty
+    std::string snapshot_dir = PLAN_SNAPSHOT_DIR;
+    int runs = 3;                   // the best execution time is kept, the first run warms the cache
+    double seq_scan_rows = 10000;   // tables above this many rows are not to be scanned sequentially
+
+    // --setup scale: rooms of room_size users each, plus one large group
+    int users = 20000;
+    int rooms = 20000;
+    int room_size = 8;
+    int messages = 1000000;
+    int big_room_members = 5000;
+    int big_room_messages = 100000;
+};
+
+// Sample arguments, picked from the seeded data
+struct Samples {
+    std::string user_id;            // plancheck_000001, member of the large group and a few rooms
+    std::string other_user_id;
+    std::string big_room_id;
+    std::string room_id;            // a room of room_size members
+    std::string room_members;       // its members as an array literal, sorted
+    std::string room_first_member;
+    int room_member_count = 0;
+    std::string middle_message_id;  // halfway through the history of the large group
+    std::string middle_timestamp;
+};
+
+struct Check {
+    std::string name;                           // operation, also the snapshot file name
+    std::string sql;
+    std::vector<std::string> params;
+    std::vector<std::string> expected_indexes;  // indexes (partitioned ones by their parent's name) to be used
+    std::set<std::string> full_scans;           // tables the statement reads whole on purpose
+    double max_buffers;                         // shared hit + read of the whole statement
+    double max_ms;                              // execution time, best of the runs
+    std::string prepare;                        // run first in the same rolled back transaction
+};
+
+// Table or index name, with the parent of a partition, and its size
+struct Relation {
+    std::string root;
+    double rows = 0;
+};
+
+struct Outcome {
+    double best_ms = -1;
+    double buffers = 0;
+    std::vector<std::string> plan;          // normalized
+    std::vector<std::string> snapshot;      // the differing snapshot, when the plan changed
+    std::vector<std::string> violations;
+    std::string snapshot_status;
+};
+
+// Statements take their arguments as text, their types come from the statement itself
+static pqxx::result exec_with(pqxx::transaction_base& txn, const std::string& sql, const std::vector<std::string>& p) {
+    switch (p.size()) {
+    case 0: return txn.exec(sql);
+    case 1: return txn.exec_params(sql, p[0]);
+    case 2: return txn.exec_params(sql, p[0], p[1]);
+    case 3: return txn.exec_params(sql, p[0], p[1], p[2]);
+    case 4: return txn.exec_params(sql, p[0], p[1], p[2], p[3]);
+    case 5: return txn.exec_params(sql, p[0], p[1], p[2], p[3], p[4]);
+    default: throw std::runtime_error("too many parameters: " + std::to_string(p.size()));
+    }
+}
+
+// Users plancheck_000001..., rooms of room_size consecutive users, one large group of the
+// first big_room_members users, messages spread over the rooms and SEED_MONTHS months. Ids
+// are md5 based so every run produces the same rows, and the same plans.
+static void setup_data(pqxx::connection& connection, const Options& options) {
+    {
+        pqxx::work txn(connection);
+        if (!txn.exec("SELECT 1 FROM users WHERE username = 'plancheck_000001'").empty()) {
+            std::cout << "Dataset already seeded" << std::endl;
+            return;
+        }
+        txn.exec("SET LOCAL session_replication_role = replica");
+
+        std::cout << "Seeding partitions, users and rooms" << std::endl;
+        txn.exec(
+            "DO $$ DECLARE month_start TIMESTAMP; BEGIN "
+            "FOR i IN 0.." + std::to_string(SEED_MONTHS - 1) + " LOOP "
+            "month_start := TIMESTAMP '" + std::string(SEED_START) + "' + make_interval(months => i); "
+            "IF to_regclass('messages_' || to_char(month_start, 'YYYY_MM')) IS NULL THEN "
+            "EXECUTE format('CREATE TABLE %I PARTITION OF messages FOR VALUES FROM (%L) TO (%L)', "
+            "'messages_' || to_char(month_start, 'YYYY_MM'), month_start, month_start + INTERVAL '1 month'); "
+            "END IF; END LOOP; END $$"
+        );
+        txn.exec_params(
+            "INSERT INTO users (user_id, username, password_hash) "
+            "SELECT md5('plancheck-user-' || i)::uuid::text, 'plancheck_' || lpad(i::text, 6, '0'), md5('plancheck') "
+            "FROM generate_series(1, $1) AS i;",
+            options.users
+        );
+        txn.exec_params(
+            "INSERT INTO chat_rooms (room_id, room_name, created_at) "
+            "SELECT md5('plancheck-room-' || r)::uuid::text, 'Plan check ' || r, $2::timestamp + r * INTERVAL '1 minute' "
+            "FROM generate_series(0, $1) AS r;",
+            options.rooms, SEED_START
+        );
+        txn.exec_params(
+            "INSERT INTO chat_room_members (room_id, user_id) "
+            "SELECT md5('plancheck-room-' || r)::uuid::text, md5('plancheck-user-' || (((r - 1) * $2 + k) % $3 + 1))::uuid::text "
+            "FROM generate_series(1, $1) AS r, generate_series(0, $2 - 1) AS k "
+            "UNION "
+            "SELECT md5('plancheck-room-0')::uuid::text, md5('plancheck-user-' || i)::uuid::text "
+            "FROM generate_series(1, $4) AS i;",
+            options.rooms, std::min(options.room_size, options.users), options.users,
+            std::min(options.big_room_members, options.users)
+        );
+        txn.exec(
+            "INSERT INTO room_directory (user_id, room_id) "
+            "SELECT crm.user_id, crm.room_id FROM chat_room_members crm "
+            "INNER JOIN chat_rooms cr ON cr.room_id = crm.room_id WHERE cr.room_name LIKE 'Plan check %';"
+        );
+
+        // The last percent of the messages is left unread
+        std::cout << "Seeding messages" << std::endl;
+        std::string words = "(ARRAY['meeting', 'deploy', 'lunch', 'review', 'release', 'budget', 'design', 'incident'])";
+        txn.exec_params(
+            "INSERT INTO messages (message_id, content, sender_id, room_id, timestamp, is_read) "
+            "SELECT md5('plancheck-message-' || j)::uuid::text, "
+            "       " + words + "[1 + j % 8] || ' ' || " + words + "[1 + (j / 8) % 8] || ' message ' || j, "
+            "       md5('plancheck-user-' || ((((j - 1) % $2) * $3 + (j / $2) % $3) % $4 + 1))::uuid::text, "
+            "       md5('plancheck-room-' || ((j - 1) % $2 + 1))::uuid::text, "
+            "       $5::timestamp + INTERVAL '365 days' * ((j - 1)::float8 / $1), "
+            "       j <= $1 * 0.99 "
+            "FROM generate_series(1, $1) AS j;",
+            options.messages, options.rooms, std::min(options.room_size, options.users), options.users, SEED_START
+        );
+        txn.exec_params(
+            "INSERT INTO messages (message_id, content, sender_id, room_id, timestamp, is_read) "
+            "SELECT md5('plancheck-big-message-' || j)::uuid::text, "
+            "       " + words + "[1 + j % 8] || ' ' || " + words + "[1 + (j / 8) % 8] || ' big message ' || j, "
+            "       md5('plancheck-user-' || (j % $2 + 1))::uuid::text, "
+            "       md5('plancheck-room-0')::uuid::text, "
+            "       $3::timestamp + INTERVAL '365 days' * ((j - 1)::float8 / $1), "
+            "       j <= $1 * 0.99 "
+            "FROM generate_series(1, $1) AS j;",
+            options.big_room_messages, std::min(options.big_room_members, options.users), SEED_START
+        );
+        txn.commit();
+    }
+
+    // Statistics and visibility maps as a long running database would have them
+    std::cout << "Analyzing" << std::endl;
+    pqxx::nontransaction txn(connection);
+    txn.exec("VACUUM ANALYZE");
+}
+
+static bool load_samples(pqxx::connection& connection, Samples& samples) {
+    pqxx::work txn(connection);
+    pqxx::result ids = txn.exec(
+        "SELECT md5('plancheck-user-1')::uuid::text, md5('plancheck-user-2')::uuid::text, "
+        "       md5('plancheck-room-0')::uuid::text, md5('plancheck-room-1')::uuid::text, "
+        "       EXISTS (SELECT 1 FROM users WHERE username = 'plancheck_000001')"
+    );
+    if (!ids[0][4].as<bool>()) return false;
+    samples.user_id = ids[0][0].as<std::string>();
+    samples.other_user_id = ids[0][1].as<std::string>();
+    samples.big_room_id = ids[0][2].as<std::string>();
+    samples.room_id = ids[0][3].as<std::string>();
+
+    pqxx::result members = txn.exec_params(
+        "SELECT array_agg(user_id ORDER BY user_id)::text, COUNT(*), MIN(user_id) "
+        "FROM chat_room_members WHERE room_id = $1",
+        samples.room_id
+    );
+    samples.room_members = members[0][0].as<std::string>();
+    samples.room_member_count = members[0][1].as<int>();
+    samples.room_first_member = members[0][2].as<std::string>();
+
+    pqxx::result middle = txn.exec_params(
+        "SELECT message_id, timestamp::text FROM messages WHERE room_id = $1 "
+        "ORDER BY timestamp, message_id OFFSET (SELECT COUNT(*) / 2 FROM messages WHERE room_id = $1) LIMIT 1",
+        samples.big_room_id
+    );
+    if (middle.empty()) return false;
+    samples.middle_message_id = middle[0][0].as<std::string>();
+    samples.middle_timestamp = middle[0][1].as<std::string>();
+    return true;
+}
+
+// Every statement of include/queries.h, but COPY_USERS which only runs on room shards
+static std::vector<Check> make_checks(pqxx::connection& connection, const Samples& s) {
+    pqxx::nontransaction quoting(connection);
+    std::string page = "50";
+    // Timestamps as the app has them, to the second
+    std::string middle_second = s.middle_timestamp.substr(0, 19);
+    std::string new_room = "00000000-0000-0000-0000-00000000c0de";
+    return {
+        {"verify_user_credentials", queries::VERIFY_USER_CREDENTIALS, {"plancheck_000001", "wrong"},
+         {"users_username_key"}, {}, 20, 5},
+        {"get_user_conversations", queries::USER_CONVERSATIONS, {s.user_id},
+         {"chat_room_members_user", "chat_rooms_pkey"}, {}, 200, 10},
+        {"get_most_active_rooms", queries::MOST_ACTIVE_ROOMS, {s.user_id, "20"},
+         {"chat_room_members_user", "messages_room_timestamp"}, {}, 2000, 50},
+        {"find_room", queries::FIND_ROOM, {std::to_string(s.room_member_count), s.room_members, s.room_first_member},
+         {"room_directory_pkey", "room_directory_room"}, {}, 1000, 20},
+        {"create_room", queries::CREATE_ROOM, {new_room, "Plan check new room"},
+         {}, {}, 50, 10},
+        {"add_room_members", queries::ADD_ROOM_MEMBERS, {new_room, s.room_members},
+         {}, {}, 300, 20, "INSERT INTO chat_rooms (room_id, room_name) VALUES ('" + new_room + "', 'Plan check new room')"},
+        {"add_room_directory", queries::ADD_ROOM_DIRECTORY, {s.room_members, new_room},
+         {}, {}, 300, 20},
+        {"users_by_id", queries::USERS_BY_ID, {s.room_members},
+         {"users_pkey"}, {}, 100, 5},
+        {"get_all_users_except", queries::ALL_USERS_EXCEPT, {s.user_id},
+         {}, {"users"}, 1500, 100},
+        {"get_room_messages", queries::ROOM_HISTORY, {s.room_id},
+         {"messages_room_timestamp"}, {}, 500, 20},
+        {"mark_room_messages_read", queries::MARK_ROOM_READ, {s.room_id},
+         {"messages_room_timestamp"}, {}, 500, 20},
+        {"get_room_messages_after", queries::MESSAGES_AFTER, {s.big_room_id, s.middle_message_id, middle_second, page},
+         {"messages_room_timestamp"}, {}, 1000, 20},
+        {"open_room", queries::latest_messages(quoting.quote(s.big_room_id), std::stoi(page)), {},
+         {"messages_room_timestamp"}, {}, 500, 10},
+        {"get_room_messages_before", queries::MESSAGES_BEFORE, {s.big_room_id, s.middle_message_id, middle_second, page},
+         {"messages_room_timestamp"}, {}, 1000, 20},
+        {"get_room_messages_around", queries::MESSAGES_AROUND, {s.big_room_id, s.middle_message_id, "26", "26"},
+         {"messages_room_timestamp"}, {}, 1000, 20},
+        {"get_room_messages_at", queries::MESSAGES_AT, {s.big_room_id, s.middle_timestamp, "26", "26"},
+         {"messages_room_timestamp"}, {}, 500, 10},
+        {"search_messages", queries::SEARCH_MESSAGES, {s.user_id, SEARCH_TERMS, "0", "", page},
+         {"chat_room_members_user"}, {}, 20000, 500},
+        {"send_message", queries::INSERT_MESSAGE, {"00000000-0000-0000-0000-0000000c0de5", "plan check", s.user_id, s.room_id},
+         {}, {}, 200, 20},
+        {"get_username_by_id", queries::USERNAME_BY_ID, {s.other_user_id},
+         {"users_pkey"}, {}, 20, 5},
+        {"get_room_members_page", queries::ROOM_MEMBERS_PAGE, {s.big_room_id, s.other_user_id, s.user_id, "100"},
+         {"chat_room_members_pkey", "users_pkey"}, {}, 600, 20},
+        {"get_room_info", queries::room_info(quoting.quote(s.big_room_id), quoting.quote(s.user_id), 3), {},
+         {"chat_room_members_pkey", "chat_rooms_pkey"}, {}, 300, 20},
+    };
+}
+
+// Every table and index with the parent of the partitioned ones, and its size
+static std::map<std::string, Relation> load_relations(pqxx::connection& connection) {
+    std::map<std::string, Relation> relations;
+    pqxx::work txn(connection);
+    pqxx::result result = txn.exec(
+        "SELECT c.relname, COALESCE(r.relname, c.relname), GREATEST(c.reltuples, 0)::float8 "
+        "FROM pg_class c "
+        "INNER JOIN pg_namespace n ON n.oid = c.relnamespace "
+        "LEFT JOIN pg_class r ON r.oid = pg_partition_root(c.oid) "
+        "WHERE n.nspname = 'public' AND c.relkind IN ('r', 'p', 'i', 'I')"
+    );
+    for (const auto& row : result) {
+        relations[row[0].as<std::string>()] = Relation{row[1].as<std::string>(), row[2].as<double>()};
+    }
+    return relations;
+}
+
+// A plan without what changes from one run or one month to the next: costs, timings,
+// counters, partition names and the plan nodes repeated for each of the partitions
+static std::vector<std::string> normalize_plan(const std::vector<std::string>& lines) {
+    static const char* const DROPPED[] = {
+        "Buffers:", "Planning", "Execution Time", "Heap Fetches", "Heap Blocks", "Rows Removed", "Sort Method",
+        "Memory Usage", "Worker", "JIT", "Functions:", "Options:", "Timing:", "Buckets:", "Batches:",
+        "Full-sort Groups", "Pre-sorted Groups", "I/O Timings", "Trigger", "Subplans Removed", "Memory:"
+    };
+    static const std::regex costs(R"(  \(cost=[^)]*\)| \(actual [^)]*\)| \(never executed\))");
+    static const std::regex partitions(R"(messages_(default|\d{4}_\d{2}))");
+    static const std::regex numbered_aliases(R"(\b([a-z]+)_\d+\b)");
+
+    struct Node {
+        int indent;
+        std::string text;
+        std::vector<std::string> details;
+        std::vector<Node> children;
+    };
+    Node root{-1, "", {}, {}};
+    std::vector<Node*> path{&root};
+
+    for (const auto& line : lines) {
+        std::size_t start = line.find_first_not_of(' ');
+        if (start == std::string::npos) continue;
+        std::string text = line.substr(start);
+        if (std::any_of(std::begin(DROPPED), std::end(DROPPED), [&text](const char* prefix) {
+                return text.compare(0, std::strlen(prefix), prefix) == 0;
+            })) {
+            continue;
+        }
+
+        text = std::regex_replace(text, costs, "");
+        text = std::regex_replace(text, partitions, "messages_<partition>");
+        text = std::regex_replace(text, numbered_aliases, "$1_n");
+
+        auto starts_with = [&text](const char* prefix) { return text.compare(0, std::strlen(prefix), prefix) == 0; };
+        bool arrow = starts_with("->");
+        bool subplan = starts_with("InitPlan") || starts_with("SubPlan") || starts_with("CTE ");
+        if (arrow || subplan || path.size() == 1) {
+            int indent = static_cast<int>(start);
+            if (arrow) text = text.substr(text.find_first_not_of(' ', 2));
+            while (path.size() > 1 && path.back()->indent >= indent) path.pop_back();
+            path.back()->children.push_back(Node{indent, text, {}, {}});
+            path.push_back(&path.back()->children.back());
+        } else {
+            path.back()->details.push_back(text);
+        }
+    }
+
+    // Siblings equal to the one before them are left out, the partitions of one table
+    // all have the same plan
+    std::function<void(const Node&, int, std::vector<std::string>&)> render =
+        [&render](const Node& node, int depth, std::vector<std::string>& out) {
+            out.push_back(std::string(depth * 2, ' ') + node.text);
+            for (const auto& detail : node.details) out.push_back(std::string(depth * 2 + 4, ' ') + detail);
+            std::vector<std::string> previous;
+            for (const auto& child : node.children) {
+                std::vector<std::string> rendered;
+                render(child, depth + 1, rendered);
+                if (rendered == previous) continue;
+                out.insert(out.end(), rendered.begin(), rendered.end());
+                previous = std::move(rendered);
+            }
+        };
+    std::vector<std::string> normalized;
+    for (const auto& node : root.children) render(node, 0, normalized);
+    return normalized;
+}
+
+// Lines only in the snapshot (-) or only in the current plan (+), in order
+static void print_diff(const std::vector<std::string>& before, const std::vector<std::string>& after) {
+    std::vector<std::vector<int>> common(before.size() + 1, std::vector<int>(after.size() + 1, 0));
+    for (std::size_t i = before.size(); i-- > 0;) {
+        for (std::size_t j = after.size(); j-- > 0;) {
+            common[i][j] = before[i] == after[j] ? common[i + 1][j + 1] + 1
+                                                 : std::max(common[i + 1][j], common[i][j + 1]);
+        }
+    }
+    std::size_t i = 0, j = 0;
+    while (i < before.size() || j < after.size()) {
+        if (i < before.size() && j < after.size() && before[i] == after[j]) {
+            std::cout << "        " << before[i] << "\n";
+            ++i;
+            ++j;
+        } else if (j < after.size() && (i == before.size() || common[i][j + 1] >= common[i + 1][j])) {
+            std::cout << "      + " << after[j++] << "\n";
+        } else {
+            std::cout << "      - " << before[i++] << "\n";
+        }
+    }
+}
+
+static Outcome run_check(pqxx::connection& connection, const Check& check, const Options& options,
+                         const std::map<std::string, Relation>& relations) {
+    static const std::regex seq_scan(R"(^(?:Parallel )?Seq Scan on (\S+))");
+    static const std::regex index_scan(R"(^(?:Parallel )?Index (?:Only )?Scan (?:Backward )?using (\S+) on)");
+    static const std::regex bitmap_scan(R"(^Bitmap Index Scan on (\S+))");
+    static const std::regex buffers(R"(Buffers: shared(?: hit=(\d+))?(?: read=(\d+))?)");
+    static const std::regex execution_time(R"(Execution Time: ([0-9.]+) ms)");
+
+    Outcome outcome;
+    std::vector<std::string> lines;
+    for (int run = 0; run < std::max(options.runs, 1); ++run) {
+        // Never committed, the writes are undone
+        pqxx::work txn(connection);
+        if (!check.prepare.empty()) txn.exec(check.prepare);
+        pqxx::result result = exec_with(txn, "EXPLAIN (ANALYZE, BUFFERS) " + check.sql, check.params);
+        lines.clear();
+        for (const auto& row : result) lines.push_back(row[0].as<std::string>());
+
+        bool root_buffers = false;
+        for (const auto& line : lines) {
+            std::smatch match;
+            if (std::regex_search(line, match, execution_time)) {
+                double ms = std::stod(match[1].str());
+                if (outcome.best_ms < 0 || ms < outcome.best_ms) outcome.best_ms = ms;
+            } else if (!root_buffers && std::regex_search(line, match, buffers)) {
+                // The first one is the statement's total
+                outcome.buffers = (match[1].matched ? std::stod(match[1].str()) : 0)
+                                + (match[2].matched ? std::stod(match[2].str()) : 0);
+                root_buffers = true;
+            }
+        }
+    }
+
+    std::set<std::string> used_indexes;
+    std::set<std::string> reported;
+    for (const auto& line : lines) {
+        std::size_t start = line.find_first_not_of(' ');
+        if (start == std::string::npos) continue;
+        std::string text = line.substr(start);
+        if (text.compare(0, 2, "->") == 0) text = text.substr(text.find_first_not_of(' ', 2));
+
+        std::smatch match;
+        if (std::regex_search(text, match, seq_scan)) {
+            auto relation = relations.find(match[1].str());
+            if (relation == relations.end()) continue;
+            const Relation& table = relation->second;
+            if (table.rows > options.seq_scan_rows && !check.full_scans.count(table.root)
+                && reported.insert(match[1].str()).second) {
+                char violation[256];
+                std::snprintf(violation, sizeof(violation), "sequential scan of %s (%s, %.0f rows)",
+                              match[1].str().c_str(), table.root.c_str(), table.rows);
+                outcome.violations.push_back(violation);
+            }
+        } else if (std::regex_search(text, match, index_scan) || std::regex_search(text, match, bitmap_scan)) {
+            auto relation = relations.find(match[1].str());
+            used_indexes.insert(relation == relations.end() ? match[1].str() : relation->second.root);
+        }
+    }
+    for (const auto& index : check.expected_indexes) {
+        if (!used_indexes.count(index)) outcome.violations.push_back("index " + index + " not used");
+    }
+
+    char ceiling[128];
+    if (outcome.buffers > check.max_buffers) {
+        std::snprintf(ceiling, sizeof(ceiling), "%.0f buffers, ceiling %.0f", outcome.buffers, check.max_buffers);
+        outcome.violations.push_back(ceiling);
+    }
+    if (outcome.best_ms > check.max_ms) {
+        std::snprintf(ceiling, sizeof(ceiling), "%.2f ms, ceiling %.0f ms", outcome.best_ms, check.max_ms);
+        outcome.violations.push_back(ceiling);
+    }
+
+    // Plans are compared once normalized, a change fails until its snapshot is updated
+    outcome.plan = normalize_plan(lines);
+    std::filesystem::path snapshot = std::filesystem::path(options.snapshot_dir) / (check.name + ".plan");
+    std::vector<std::string> previous;
+    bool existed = std::filesystem::exists(snapshot);
+    if (existed) {
+        std::ifstream in(snapshot);
+        std::string line;
+        while (std::getline(in, line)) previous.push_back(line);
+    }
+    if (existed && previous == outcome.plan) {
+        outcome.snapshot_status = "same plan";
+    } else if (existed && !options.update_snapshots) {
+        outcome.snapshot_status = "plan changed";
+        outcome.violations.push_back("plan differs from " + snapshot.string() + ":");
+        outcome.snapshot = std::move(previous);
+    } else if (!options.update_snapshots) {
+        // Accepting it silently would let any plan through on a fresh checkout
+        outcome.snapshot_status = "no snapshot";
+        outcome.violations.push_back("no snapshot " + snapshot.string() + ", run with --update-snapshots");
+    } else {
+        std::filesystem::create_directories(options.snapshot_dir);
+        std::ofstream out(snapshot);
+        for (const auto& line : outcome.plan) out << line << "\n";
+        outcome.snapshot_status = existed ? "snapshot updated" : "snapshot written";
+    }
+    return outcome;
+}
+
+static bool parse_options(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&arg](const char* flag) -> const char* {
+            std::size_t length = std::strlen(flag);
+            return arg.compare(0, length, flag) == 0 ? arg.c_str() + length : nullptr;
+        };
+        if (arg == "--setup") options.setup = true;
+        else if (arg == "--update-snapshots") options.update_snapshots = true;
+        else if (auto v = value("--only=")) options.only = v;
+        else if (auto v = value("--snapshots=")) options.snapshot_dir = v;
+        else if (auto v = value("--runs=")) options.runs = std::atoi(v);
+        else if (auto v = value("--seq-scan-rows=")) options.seq_scan_rows = std::atof(v);
+        else if (auto v = value("--users=")) options.users = std::atoi(v);
+        else if (auto v = value("--rooms=")) options.rooms = std::atoi(v);
+        else if (auto v = value("--room-size=")) options.room_size = std::atoi(v);
+        else if (auto v = value("--messages=")) options.messages = std::atoi(v);
+        else if (auto v = value("--big-room-members=")) options.big_room_members = std::atoi(v);
+        else if (auto v = value("--big-room-messages=")) options.big_room_messages = std::atoi(v);
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    return options.users > 1 && options.rooms > 0 && options.room_size > 1 && options.messages > 0
+        && options.big_room_members > 1 && options.big_room_messages > 0;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--setup] [--update-snapshots] [--only=name] [--snapshots=dir]"
+                     " [--runs=N] [--seq-scan-rows=N] [--users=N] [--rooms=N] [--room-size=N] [--messages=N]"
+                     " [--big-room-members=N] [--big-room-messages=N]" << std::endl;
+        return 2;
+    }
+    if (std::getenv("VAOAPP_PLAN_DB")) options.conn_str = std::getenv("VAOAPP_PLAN_DB");
+
+    int failed = 0;
+    int checked = 0;
+    try {
+        pqxx::connection connection(options.conn_str);
+        if (options.setup) setup_data(connection, options);
+
+        Samples samples;
+        if (!load_samples(connection, samples)) {
+            std::cerr << "No plan check dataset, run with --setup first" << std::endl;
+            return 1;
+        }
+        std::map<std::string, Relation> relations = load_relations(connection);
+
+        std::printf("%-26s %10s %10s  %s\n", "statement", "ms", "buffers", "result");
+        for (const auto& check : make_checks(connection, samples)) {
+            if (!options.only.empty() && check.name.find(options.only) == std::string::npos) continue;
+            ++checked;
+            Outcome outcome;
+            try {
+                outcome = run_check(connection, check, options, relations);
+            } catch (const std::exception& e) {
+                outcome.violations.push_back(std::string("error: ") + e.what());
+            }
+
+            if (!outcome.violations.empty()) ++failed;
+            std::printf("%-26s %10.2f %10.0f  %s%s%s\n", check.name.c_str(), outcome.best_ms, outcome.buffers,
+                        outcome.violations.empty() ? "ok" : "FAILED",
+                        outcome.snapshot_status.empty() ? "" : ", ", outcome.snapshot_status.c_str());
+            for (const auto& violation : outcome.violations) std::printf("    %s\n", violation.c_str());
+
+            if (outcome.snapshot_status == "plan changed") print_diff(outcome.snapshot, outcome.plan);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Plan check failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::printf("\n%d of %d statements failed\n", failed, checked);
+    return failed == 0 ? 0 : 1;
+}
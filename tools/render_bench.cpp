@@ -0,0 +1,370 @@
+// Rendering benchmark of the real chat views, without a database. Each case builds a view
+// in its own window from in-memory data, then measures:
+//   construct_ms     building the view (widgets for every message or room)
+//   first_frame_ms   from the start of construction to the end of the first painted frame
+//   scroll_p50_ms... work per frame (before-paint to after-paint) while scrolling through it
+//   rss_delta_kb     resident memory added by the view once shown
+//
+// ChatRoomView gets its messages as a RoomSnapshot, ChatListView its rooms through
+// queue_room_activity. The DatabaseHandler points at a closed local port, so the few
+// lookups the views still make fail right away and they fall back to what they were given.
+// Their connection errors are filtered out of stderr, any other error is printed.
+//
+//   xvfb-run -a vaoapp_render_bench --messages=1000,10000,100000 --rooms=100,1000,10000 --output=new.tsv
+//   xvfb-run -a vaoapp_render_bench --output=new.tsv --compare=old.tsv
+//
+// Results are written as "case<TAB>metric<TAB>value" lines, --compare prints the change
+// of every metric against a previous run.
+
+#include <gtkmm.h>
+#include "chat_list_view.h"
+#include "chat_room_view.h"
+#include "database_handler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const char* const UNREACHABLE_DB = "host=127.0.0.1 port=9 connect_timeout=1";
+static const char* const BENCH_USER_ID = "render-bench-user";
+
+// What the lookups against UNREACHABLE_DB report, every such line is expected
+static const char* const EXPECTED_ERROR = "Database connection error";
+
+// Passes std::cerr through line by line, except the expected failed lookups, which are
+// only counted. Any other error of the views still shows up. The background workers
+// write to it too, hence the lock.
+class ExpectedErrorFilter : public std::streambuf {
+public:
+    explicit ExpectedErrorFilter(std::ostream& stream) : stream(stream), target(stream.rdbuf(this)) {}
+    ~ExpectedErrorFilter() override {
+        stream.rdbuf(target);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!line.empty()) pass_line();
+    }
+    ExpectedErrorFilter(const ExpectedErrorFilter&) = delete;
+    ExpectedErrorFilter& operator=(const ExpectedErrorFilter&) = delete;
+
+    std::size_t hidden() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hidden_lines;
+    }
+
+protected:
+    int overflow(int c) override {
+        if (c == traits_type::eof()) return traits_type::not_eof(c);
+        std::lock_guard<std::mutex> lock(mutex);
+        line.push_back(static_cast<char>(c));
+        if (c == '\n') pass_line();
+        return c;
+    }
+
+private:
+    void pass_line() {
+        if (line.find(EXPECTED_ERROR) != std::string::npos) {
+            ++hidden_lines;
+        } else {
+            target->sputn(line.data(), static_cast<std::streamsize>(line.size()));
+            target->pubsync();
+        }
+        line.clear();
+    }
+
+    std::mutex mutex;
+    std::ostream& stream;
+    std::streambuf* target;
+    std::string line;
+    std::size_t hidden_lines = 0;
+};
+
+struct Options {
+    std::vector<int> message_counts{1000, 10000};
+    std::vector<int> room_counts{100, 1000};
+    int scroll_frames = 120;
+    std::string output_path;
+    std::string compare_path;
+};
+
+struct Result {
+    std::string case_name;
+    std::vector<std::pair<std::string, double>> metrics;
+};
+
+static double ms_between(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Resident set size of the process, from /proc
+static long resident_kb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) return std::atol(line.c_str() + 6);
+    }
+    return 0;
+}
+
+// Run the main loop until done or the timeout, a short timer keeps it from blocking
+static bool run_until(const std::function<bool()>& done, std::chrono::milliseconds timeout = std::chrono::seconds(60)) {
+    auto wake_up = Glib::signal_timeout().connect([]() { return true; }, 10);
+    auto context = Glib::MainContext::get_default();
+    auto deadline = Clock::now() + timeout;
+    while (!done() && Clock::now() < deadline) context->iteration(true);
+    wake_up.disconnect();
+    return done();
+}
+
+// Work done by the frame clock of a window per frame, from before-paint to after-paint
+class FrameProbe {
+private:
+    GdkFrameClock* clock;
+    gulong before_paint_id;
+    gulong after_paint_id;
+    Clock::time_point frame_start;
+
+    static void on_before_paint(GdkFrameClock*, gpointer data) {
+        static_cast<FrameProbe*>(data)->frame_start = Clock::now();
+    }
+    static void on_after_paint(GdkFrameClock*, gpointer data) {
+        auto probe = static_cast<FrameProbe*>(data);
+        probe->last_frame_end = Clock::now();
+        probe->frame_ms.push_back(ms_between(probe->frame_start, probe->last_frame_end));
+    }
+
+public:
+    std::vector<double> frame_ms;
+    Clock::time_point last_frame_end;
+
+    explicit FrameProbe(Gtk::Window& window)
+        : clock(gtk_widget_get_frame_clock(GTK_WIDGET(window.gobj()))) {
+        before_paint_id = g_signal_connect(clock, "before-paint", G_CALLBACK(on_before_paint), this);
+        after_paint_id = g_signal_connect(clock, "after-paint", G_CALLBACK(on_after_paint), this);
+    }
+    FrameProbe(const FrameProbe&) = delete;
+    FrameProbe& operator=(const FrameProbe&) = delete;
+    ~FrameProbe() {
+        g_signal_handler_disconnect(clock, before_paint_id);
+        g_signal_handler_disconnect(clock, after_paint_id);
+    }
+};
+
+// The scrolled window with the most content, the message history or the room list
+static Gtk::ScrolledWindow* find_main_scroll(Gtk::Widget& widget) {
+    Gtk::ScrolledWindow* best = dynamic_cast<Gtk::ScrolledWindow*>(&widget);
+    if (auto container = dynamic_cast<Gtk::Container*>(&widget)) {
+        for (auto* child : container->get_children()) {
+            Gtk::ScrolledWindow* found = find_main_scroll(*child);
+            if (found && (!best || found->get_vadjustment()->get_upper() > best->get_vadjustment()->get_upper())) {
+                best = found;
+            }
+        }
+    }
+    return best;
+}
+
+static double percentile(std::vector<double> values, double q) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<std::size_t>(q * values.size()))];
+}
+
+// Show a view in a fresh window and measure it, build returns it once constructed
+static Result measure_view(const std::string& case_name, const Options& options,
+                           const std::function<std::unique_ptr<Gtk::Widget>()>& build) {
+    Result result{case_name, {}};
+    long rss_before = resident_kb();
+
+    Gtk::Window window;
+    window.set_default_size(800, 900);
+    window.realize();
+    FrameProbe probe(window);
+
+    auto start = Clock::now();
+    std::unique_ptr<Gtk::Widget> view = build();
+    auto constructed = Clock::now();
+    window.add(*view);
+    window.show_all();
+    bool painted = run_until([&probe]() { return !probe.frame_ms.empty(); });
+    result.metrics.emplace_back("construct_ms", ms_between(start, constructed));
+    if (painted) {
+        result.metrics.emplace_back("first_frame_ms", ms_between(start, probe.last_frame_end));
+    } else {
+        std::cerr << case_name << ": no frame painted, first_frame_ms skipped" << std::endl;
+    }
+
+    // Let the pending idle work (scroll anchoring, deferred updates) settle first
+    run_until([]() { return !Glib::MainContext::get_default()->pending(); }, std::chrono::seconds(5));
+    result.metrics.emplace_back("rss_delta_kb", static_cast<double>(resident_kb() - rss_before));
+
+    // Scroll from the end to the start, one step per frame
+    if (Gtk::ScrolledWindow* scroll = find_main_scroll(*view)) {
+        auto adjustment = scroll->get_vadjustment();
+        double top = adjustment->get_upper() - adjustment->get_page_size();
+        probe.frame_ms.clear();
+        for (int step = 0; step < options.scroll_frames; ++step) {
+            std::size_t frames = probe.frame_ms.size();
+            adjustment->set_value(top * (1.0 - static_cast<double>(step + 1) / options.scroll_frames));
+            run_until([&]() { return probe.frame_ms.size() > frames; }, std::chrono::seconds(1));
+        }
+        result.metrics.emplace_back("scroll_p50_ms", percentile(probe.frame_ms, 0.5));
+        result.metrics.emplace_back("scroll_p95_ms", percentile(probe.frame_ms, 0.95));
+        result.metrics.emplace_back("scroll_max_ms", percentile(probe.frame_ms, 1.0));
+    }
+
+    window.remove();
+    view.reset();
+    run_until([]() { return !Glib::MainContext::get_default()->pending(); }, std::chrono::seconds(5));
+    return result;
+}
+
+// Messages from a handful of senders, ours every fifth, of varying lengths
+static RoomSnapshot make_snapshot(int message_count) {
+    static const char* const WORDS[] = {"lorem", "ipsum", "dolor", "sit", "amet", "deploy", "review", "lunch"};
+    RoomSnapshot snapshot;
+    snapshot.room_name = "Render benchmark";
+    snapshot.members = MemberSummary{19, {"sender-1", "sender-2", "sender-3"}};
+    snapshot.messages.reserve(message_count);
+    auto timestamp = std::chrono::system_clock::now() - std::chrono::minutes(message_count);
+    for (int i = 0; i < message_count; ++i) {
+        std::string content;
+        for (int word = 0; word < 3 + (i * 7) % 40; ++word) {
+            if (word > 0) content += ' ';
+            content += WORDS[(i + word) % std::size(WORDS)];
+        }
+        std::string sender_id = i % 5 == 0 ? BENCH_USER_ID : "sender-" + std::to_string(i % 19 + 1);
+        snapshot.messages.emplace_back("message-" + std::to_string(i), content, sender_id,
+                                       timestamp + std::chrono::minutes(i), true);
+    }
+    return snapshot;
+}
+
+static std::vector<Result> run_benchmarks(DatabaseHandler& db_handler, const Options& options) {
+    std::vector<Result> results;
+    for (int count : options.message_counts) {
+        RoomSnapshot snapshot = make_snapshot(count);
+        results.push_back(measure_view("chat_room_" + std::to_string(count), options, [&]() {
+            return std::make_unique<ChatRoomView>(db_handler, "render-bench-room", "Render benchmark", std::move(snapshot));
+        }));
+    }
+    for (int count : options.room_counts) {
+        results.push_back(measure_view("chat_list_" + std::to_string(count), options, [&]() {
+            auto view = std::make_unique<ChatListView>(db_handler);
+            for (int i = 0; i < count; ++i) {
+                view->queue_room_activity("room-" + std::to_string(i), "Room " + std::to_string(i));
+            }
+            return view;
+        }));
+    }
+    return results;
+}
+
+static void write_results(std::ostream& out, const std::vector<Result>& results) {
+    for (const auto& result : results) {
+        for (const auto& [metric, value] : result.metrics) {
+            out << result.case_name << '\t' << metric << '\t' << value << '\n';
+        }
+    }
+}
+
+// Change of every metric against a previous run, lower is better for all of them
+static void compare_results(const std::string& path, const std::vector<Result>& results) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Could not read " << path << std::endl;
+        return;
+    }
+    std::map<std::pair<std::string, std::string>, double> previous;
+    std::string case_name, metric;
+    double value;
+    while (file >> case_name >> metric >> value) previous[{case_name, metric}] = value;
+
+    std::printf("\n%-20s %-16s %12s %12s %9s\n", "case", "metric", "before", "after", "change");
+    for (const auto& result : results) {
+        for (const auto& [name, after] : result.metrics) {
+            auto before = previous.find({result.case_name, name});
+            if (before == previous.end()) continue;
+            double change = before->second != 0 ? (after - before->second) / before->second * 100 : 0;
+            std::printf("%-20s %-16s %12.2f %12.2f %+8.1f%%\n",
+                        result.case_name.c_str(), name.c_str(), before->second, after, change);
+        }
+    }
+}
+
+static std::vector<int> parse_counts(const char* setting) {
+    std::vector<int> counts;
+    std::stringstream entries(setting);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        if (std::atoi(entry.c_str()) > 0) counts.push_back(std::atoi(entry.c_str()));
+    }
+    return counts;
+}
+
+static bool parse_options(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--messages=", 11) == 0) {
+            options.message_counts = parse_counts(argv[i] + 11);
+        } else if (std::strncmp(argv[i], "--rooms=", 8) == 0) {
+            options.room_counts = parse_counts(argv[i] + 8);
+        } else if (std::strncmp(argv[i], "--scroll-frames=", 16) == 0) {
+            options.scroll_frames = std::max(1, std::atoi(argv[i] + 16));
+        } else if (std::strncmp(argv[i], "--output=", 9) == 0) {
+            options.output_path = argv[i] + 9;
+        } else if (std::strncmp(argv[i], "--compare=", 10) == 0) {
+            options.compare_path = argv[i] + 10;
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [--messages=N,...] [--rooms=N,...] [--scroll-frames=N]"
+                     " [--output=file] [--compare=file]" << std::endl;
+        return 2;
+    }
+
+    DatabaseHandler db_handler(UNREACHABLE_DB);
+    db_handler.setCurrentUser(User(BENCH_USER_ID, "render-bench", ""));
+
+    std::vector<Result> results;
+    auto app = Gtk::Application::create("org.vaoapp.render_bench", Gio::APPLICATION_NON_UNIQUE);
+    app->signal_activate().connect([&]() {
+        // The failed lookups are expected, keep them out of the output
+        std::size_t hidden = 0;
+        {
+            ExpectedErrorFilter filter(std::cerr);
+            results = run_benchmarks(db_handler, options);
+            hidden = filter.hidden();
+        }
+        if (hidden > 0) std::cerr << hidden << " expected database errors hidden" << std::endl;
+    });
+    int status = app->run();
+    if (status != 0) return status;
+
+    write_results(std::cout, results);
+    if (!options.output_path.empty()) {
+        std::ofstream output(options.output_path, std::ios::trunc);
+        write_results(output, results);
+    }
+    if (!options.compare_path.empty()) compare_results(options.compare_path, results);
+    return 0;
+}